@@ -0,0 +1,249 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include "kmeans_simd.hpp"
+
+namespace KMeansLib {
+
+// Index des centroïdes en petite dimension (couleurs 3D, points 2D) : une
+// grille régulière sur la boîte englobante des points, dont chaque case garde
+// la liste des seuls centroïdes qui peuvent être le plus proche d'un de ses
+// points. Un centroïde est candidat si sa distance minimale à la case ne
+// dépasse pas la plus petite distance maximale d'un centroïde à la case.
+// Les candidats sont triés par distance minimale à la case : la recherche
+// s'arrête dès que cette borne dépasse la meilleure distance trouvée. Elle
+// reste exacte (en cas d'égalité, le plus petit indice gagne, comme dans le
+// parcours complet) mais ne compare chaque point qu'à quelques centroïdes.
+//
+// Les listes sont calculées à la première visite d'une case puis gardées
+// jusqu'au build() suivant : seules les cases occupées par des points coûtent.
+// Elles sont filtrées à partir de la liste de la case deux fois plus grande qui
+// la contient (niveau supérieur d'une pyramide de grilles, jusqu'à une seule
+// case) plutôt qu'à partir des K centroïdes. Un centroïde identique à un
+// centroïde d'indice plus petit ne peut jamais gagner : il n'est dans aucune
+// liste. nearest() peut être appelé depuis plusieurs threads.
+class CentroidGrid {
+public:
+    static constexpr size_t kMaxDims = 3;
+    static constexpr int kMaxCellsPerAxis = 64;
+
+    // lo / hi : bornes des points sur chaque axe (un point hors de la boîte est
+    // comparé à tous les centroïdes) ; cellsPerAxis (arrondi à une puissance de
+    // 2) = 0 : choisi selon K
+    void build(const double* centroids, size_t count, size_t dims, size_t stride,
+               const double* lo, const double* hi, int cellsPerAxis = 0) {
+        if (dims == 0 || dims > kMaxDims || count == 0) {
+            throw std::invalid_argument("CentroidGrid: 1 à 3 dimensions et au moins un centroïde");
+        }
+        dims_ = dims;
+        count_ = count;
+        centroids_.resize(count * dims);
+        for (size_t j = 0; j < count; ++j) {
+            std::copy(centroids + j * stride, centroids + j * stride + dims, &centroids_[j * dims]);
+        }
+
+        // Premier indice de chaque centroïde distinct
+        distinct_.resize(count);
+        std::iota(distinct_.begin(), distinct_.end(), 0);
+        auto coordinates = [&](int j) { return &centroids_[j * dims]; };
+        std::stable_sort(distinct_.begin(), distinct_.end(), [&](int a, int b) {
+            return std::lexicographical_compare(coordinates(a), coordinates(a) + dims,
+                                                coordinates(b), coordinates(b) + dims);
+        });
+        distinct_.erase(std::unique(distinct_.begin(), distinct_.end(), [&](int a, int b) {
+            return std::equal(coordinates(a), coordinates(a) + dims, coordinates(b));
+        }), distinct_.end());
+        std::sort(distinct_.begin(), distinct_.end());
+
+        if (cellsPerAxis <= 0) {
+            const double n = static_cast<double>(distinct_.size());
+            cellsPerAxis = static_cast<int>(std::ceil(2.0 * std::pow(n, 1.0 / dims)));
+        }
+        int cells = 1;
+        while (cells < std::min(cellsPerAxis, kMaxCellsPerAxis)) cells *= 2;
+        for (size_t d = 0; d < dims; ++d) {
+            lo_[d] = lo[d];
+            hi_[d] = hi[d];
+            const double extent = hi[d] - lo[d];
+            cellSize_[d] = extent > 0.0 ? extent / cells : 1.0;
+        }
+
+        levels_.clear();
+        for (int axis = cells; axis >= 1; axis /= 2) {
+            Level level;
+            level.axisCells = axis;
+            size_t total = 1;
+            for (size_t d = 0; d < dims; ++d) total *= static_cast<size_t>(axis);
+            level.lists.resize(total);
+            level.ready.reset(new std::once_flag[total]);
+            levels_.push_back(std::move(level));
+        }
+    }
+
+    size_t dims() const { return dims_; }
+    size_t count() const { return count_; }
+    int cellsPerAxis() const { return levels_.empty() ? 0 : levels_.front().axisCells; }
+
+    // Indice du centroïde le plus proche de p (distance calculée en double).
+    // Si evaluated est fourni, il reçoit en plus le nombre de distances calculées.
+    template <int Dim = Dynamic, typename P>
+    int nearest(const P* p, uint64_t* evaluated = nullptr) const {
+        std::array<int, kMaxDims> cell;
+        if (!locate<Dim>(p, cell)) {
+            if (evaluated) *evaluated += distinct_.size();
+            return nearestDistinct<Dim>(p);
+        }
+        const std::vector<Candidate>& list = candidates(0, cell);
+
+        const size_t dims = Dim != Dynamic ? Dim : dims_;
+        double best = std::numeric_limits<double>::infinity();
+        double limit = best;
+        int bestCentroid = 0;
+        size_t visited = 0;
+        for (const Candidate& candidate : list) {
+            if (candidate.bound > limit) break;
+            ++visited;
+            const double sum = distance<Dim>(p, candidate.id, dims);
+            if (sum < best || (sum == best && candidate.id < bestCentroid)) {
+                best = sum;
+                limit = sum * (1.0 + 1e-12);   // marge contre les arrondis de la borne
+                bestCentroid = candidate.id;
+            }
+        }
+        if (evaluated) *evaluated += visited;
+        return bestCentroid;
+    }
+
+private:
+    // Centroïde candidat et sa distance minimale (au carré) à la case
+    struct Candidate {
+        int id;
+        double bound;
+    };
+
+    // Un niveau de la pyramide : axisCells cases par axe
+    struct Level {
+        int axisCells = 1;
+        mutable std::vector<std::vector<Candidate>> lists;
+        std::unique_ptr<std::once_flag[]> ready;
+    };
+
+    template <int Dim, typename P>
+    double distance(const P* p, int j, size_t dims) const {
+        const double* c = &centroids_[j * dims];
+        double sum = 0.0;
+        for (size_t d = 0; d < dims; ++d) {
+            double diff = static_cast<double>(p[d]) - c[d];
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+    template <int Dim, typename P>
+    bool locate(const P* p, std::array<int, kMaxDims>& cell) const {
+        const size_t dims = Dim != Dynamic ? Dim : dims_;
+        const int cells = levels_.front().axisCells;
+        for (size_t d = 0; d < dims; ++d) {
+            const double x = static_cast<double>(p[d]);
+            if (!(x >= lo_[d] && x <= hi_[d])) return false;
+            cell[d] = std::min(cells - 1, static_cast<int>((x - lo_[d]) / cellSize_[d]));
+        }
+        return true;
+    }
+
+    // Point hors de la grille : parcours de tous les centroïdes distincts
+    template <int Dim, typename P>
+    int nearestDistinct(const P* p) const {
+        const size_t dims = Dim != Dynamic ? Dim : dims_;
+        double best = std::numeric_limits<double>::infinity();
+        int bestCentroid = 0;
+        for (int j : distinct_) {
+            const double sum = distance<Dim>(p, j, dims);
+            if (sum < best) {
+                best = sum;
+                bestCentroid = j;
+            }
+        }
+        return bestCentroid;
+    }
+
+    // Liste de la case `cell` (coordonnées au niveau `level`)
+    const std::vector<Candidate>& candidates(size_t level, const std::array<int, kMaxDims>& cell) const {
+        const Level& grid = levels_[level];
+        size_t index = 0;
+        for (size_t d = 0; d < dims_; ++d) index = index * grid.axisCells + cell[d];
+        std::call_once(grid.ready[index], [&] {
+            if (level + 1 == levels_.size()) {
+                grid.lists[index] = filter(level, cell, distinct_.data(), distinct_.size(), nullptr);
+                return;
+            }
+            std::array<int, kMaxDims> parent{};
+            for (size_t d = 0; d < dims_; ++d) parent[d] = cell[d] / 2;
+            const std::vector<Candidate>& superset = candidates(level + 1, parent);
+            grid.lists[index] = filter(level, cell, nullptr, superset.size(), superset.data());
+        });
+        return grid.lists[index];
+    }
+
+    // Centroïdes (ids, ou ceux de la liste parente) qui restent candidats pour
+    // la case. Un centroïde écarté pour une case l'est pour toutes les cases
+    // qu'elle contient : le filtrage à partir de la case parente est exact.
+    std::vector<Candidate> filter(size_t level, const std::array<int, kMaxDims>& cell,
+                                  const int* ids, size_t n, const Candidate* parent) const {
+        // Boîte de la case, élargie d'une fraction de case : un point placé dans
+        // une case voisine par l'arrondi du calcul d'indice y reste couvert
+        std::array<double, kMaxDims> boxLo{}, boxHi{};
+        for (size_t d = 0; d < dims_; ++d) {
+            const double size = cellSize_[d] * static_cast<double>(size_t(1) << level);
+            const double margin = 1e-6 * cellSize_[d];
+            boxLo[d] = lo_[d] + cell[d] * size - margin;
+            boxHi[d] = lo_[d] + (cell[d] + 1) * size + margin;
+        }
+
+        std::vector<Candidate> list(n);
+        double bound = std::numeric_limits<double>::infinity();
+        for (size_t k = 0; k < n; ++k) {
+            const int j = ids ? ids[k] : parent[k].id;
+            const double* c = &centroids_[j * dims_];
+            double nearSum = 0.0, farSum = 0.0;
+            for (size_t d = 0; d < dims_; ++d) {
+                const double below = boxLo[d] - c[d], above = c[d] - boxHi[d];
+                const double nearGap = std::max(0.0, std::max(below, above));
+                const double farGap = std::max(std::abs(below), std::abs(above));
+                nearSum += nearGap * nearGap;
+                farSum += farGap * farGap;
+            }
+            list[k] = {j, nearSum};
+            bound = std::min(bound, farSum);
+        }
+
+        // Légère marge relative contre les écarts d'arrondi entre les bornes et
+        // les distances réellement calculées par nearest()
+        bound *= 1.0 + 1e-9;
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [&](const Candidate& c) { return c.bound > bound; }),
+                   list.end());
+        std::sort(list.begin(), list.end(), [](const Candidate& a, const Candidate& b) {
+            return a.bound < b.bound || (a.bound == b.bound && a.id < b.id);
+        });
+        return list;
+    }
+
+    size_t dims_ = 0;
+    size_t count_ = 0;
+    std::vector<double> centroids_;   // copie compacte (count x dims)
+    std::vector<int> distinct_;       // premier indice de chaque centroïde distinct
+    std::array<double, kMaxDims> lo_{}, hi_{}, cellSize_{};
+    std::vector<Level> levels_;       // de la grille la plus fine à une seule case
+};
+
+} // namespace KMeansLib
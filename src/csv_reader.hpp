@@ -0,0 +1,184 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <vector>
+#include "kmeans_lib.hpp"
+#include "mapped_file.hpp"
+
+namespace KMeansLib {
+
+// Lecture rapide de fichiers CSV numériques à N colonnes.
+//
+// Le texte (projeté en mémoire) est découpé en blocs d'environ kCsvChunkBytes,
+// alignés sur les fins de ligne. Une première passe compte les lignes de chaque
+// bloc, ce qui fixe la ligne de départ de chaque bloc dans la matrice de sortie ;
+// la seconde passe analyse les blocs en parallèle avec std::from_chars et écrit
+// directement dans cette matrice. Les lignes rejetées sont seulement comptées
+// (avec les numéros des premières) au lieu d'être affichées une par une.
+constexpr size_t kCsvChunkBytes = size_t(1) << 20;
+constexpr size_t kCsvMalformedSamples = 5;
+
+struct CsvOptions {
+    char delimiter = ',';       // les espaces autour des valeurs sont ignorés
+    bool skipHeader = false;    // ignorer la première ligne
+    size_t columns = 0;         // 0 = nombre de colonnes de la première ligne valide
+    int numThreads = 1;         // 0 = tous les coeurs
+};
+
+struct CsvResult {
+    PointMatrix points;                     // une ligne par ligne valide, dans l'ordre du fichier
+    size_t malformedLines = 0;              // lignes non vides rejetées
+    std::vector<size_t> malformedSamples;   // numéros (à partir de 1) des premières lignes rejetées
+};
+
+namespace detail {
+
+inline bool isCsvSpace(char c, char delimiter) {
+    return (c == ' ' || c == '\t' || c == '\r') && c != delimiter;
+}
+
+// Analyse la ligne [begin, end) ; écrit au plus maxValues valeurs dans out et
+// renvoie leur nombre, ou -1 si un champ est vide, n'est pas un nombre ou s'il y
+// a trop de champs. Une ligne vide (ou blanche) donne 0.
+inline long parseCsvLine(const char* begin, const char* end, char delimiter,
+                         double* out, size_t maxValues) {
+    const char* cursor = begin;
+    size_t count = 0;
+    while (true) {
+        // Début de ligne ou juste après un séparateur
+        while (cursor < end && isCsvSpace(*cursor, delimiter)) ++cursor;
+        if (cursor == end) return count == 0 ? 0 : -1;
+        if (count == maxValues) return -1;
+        if (*cursor == '+') ++cursor;   // from_chars n'accepte pas le signe +
+        auto parsed = std::from_chars(cursor, end, out[count]);
+        if (parsed.ec != std::errc()) return -1;
+        ++count;
+        cursor = parsed.ptr;
+        while (cursor < end && isCsvSpace(*cursor, delimiter)) ++cursor;
+        if (cursor == end) return static_cast<long>(count);
+        if (*cursor != delimiter) return -1;
+        ++cursor;
+    }
+}
+
+inline const char* csvLineEnd(const char* cursor, const char* end) {
+    const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+    return newline ? newline : end;
+}
+
+// Nombre de colonnes de la première ligne entièrement numérique (0 si aucune)
+inline size_t detectCsvColumns(const char* begin, const char* end, char delimiter) {
+    std::vector<double> values;
+    for (const char* line = begin; line < end;) {
+        const char* lineEnd = csvLineEnd(line, end);
+        size_t fields = static_cast<size_t>(std::count(line, lineEnd, delimiter)) + 1;
+        values.resize(std::max(values.size(), fields));
+        long count = parseCsvLine(line, lineEnd, delimiter, values.data(), fields);
+        if (count > 0) return static_cast<size_t>(count);
+        line = lineEnd + 1;
+    }
+    return 0;
+}
+
+} // namespace detail
+
+// Analyse un texte CSV déjà en mémoire
+inline CsvResult parseCsv(const char* data, size_t size, const CsvOptions& options = {}) {
+    const char* begin = data;
+    const char* end = data + size;
+    size_t firstLine = 1;
+    if (options.skipHeader && begin < end) {
+        begin = std::min(end, detail::csvLineEnd(begin, end) + 1);
+        ++firstLine;
+    }
+
+    CsvResult result;
+    const size_t columns = options.columns ? options.columns
+                                           : detail::detectCsvColumns(begin, end, options.delimiter);
+    if (columns == 0) {
+        // Aucune ligne numérique : toutes les lignes non vides sont rejetées
+        for (const char* line = begin; line < end; ++firstLine) {
+            const char* lineEnd = detail::csvLineEnd(line, end);
+            if (detail::parseCsvLine(line, lineEnd, options.delimiter, nullptr, 0) != 0) {
+                if (result.malformedSamples.size() < kCsvMalformedSamples) {
+                    result.malformedSamples.push_back(firstLine);
+                }
+                ++result.malformedLines;
+            }
+            line = lineEnd + 1;
+        }
+        result.points = PointMatrix(0, columns);
+        return result;
+    }
+
+    // Blocs alignés sur les fins de ligne
+    const size_t bytes = static_cast<size_t>(end - begin);
+    const size_t chunks = (bytes + kCsvChunkBytes - 1) / kCsvChunkBytes;
+    std::vector<const char*> bounds(chunks + 1, end);
+    bounds[0] = begin;
+    for (size_t c = 1; c < chunks; ++c) {
+        const char* nominal = std::max(bounds[c - 1], begin + c * kCsvChunkBytes);
+        bounds[c] = nominal < end ? std::min(end, detail::csvLineEnd(nominal, end) + 1) : end;
+    }
+
+    // Passe 1 : nombre de lignes par bloc -> première ligne de chaque bloc
+    ThreadPool pool(options.numThreads);
+    std::vector<size_t> lines(chunks + 1, 0);
+    pool.parallelFor(chunks, [&](size_t c) {
+        const char* from = bounds[c];
+        const char* to = bounds[c + 1];
+        size_t count = static_cast<size_t>(std::count(from, to, '\n'));
+        if (to > from && to[-1] != '\n') ++count;   // dernière ligne sans fin de ligne
+        lines[c + 1] = count;
+    });
+    std::partial_sum(lines.begin(), lines.end(), lines.begin());
+
+    // Passe 2 : analyse en parallèle, chaque bloc écrit à partir de sa première ligne
+    PointMatrix points(lines[chunks], columns);
+    std::vector<size_t> rows(chunks, 0), malformed(chunks, 0);
+    std::vector<std::vector<size_t>> samples(chunks);
+    pool.parallelFor(chunks, [&](size_t c) {
+        double* out = points.row(lines[c]);
+        size_t lineNumber = firstLine + lines[c];
+        for (const char* line = bounds[c]; line < bounds[c + 1]; ++lineNumber) {
+            const char* lineEnd = detail::csvLineEnd(line, bounds[c + 1]);
+            long count = detail::parseCsvLine(line, lineEnd, options.delimiter, out, columns);
+            if (count == static_cast<long>(columns)) {
+                out += columns;
+                ++rows[c];
+            } else if (count != 0) {
+                if (samples[c].size() < kCsvMalformedSamples) samples[c].push_back(lineNumber);
+                ++malformed[c];
+            }
+            line = lineEnd + 1;
+        }
+    });
+
+    // Compactage : les lignes vides ou rejetées laissent des trous en fin de bloc
+    size_t total = 0;
+    for (size_t c = 0; c < chunks; ++c) {
+        if (total != lines[c] && rows[c] > 0) {
+            std::memmove(points.row(total), points.row(lines[c]), rows[c] * columns * sizeof(double));
+        }
+        total += rows[c];
+        result.malformedLines += malformed[c];
+        for (size_t line : samples[c]) {
+            if (result.malformedSamples.size() < kCsvMalformedSamples) result.malformedSamples.push_back(line);
+        }
+    }
+    points.resize(total);
+    result.points = std::move(points);
+    return result;
+}
+
+// Lit un fichier CSV (projeté en mémoire, sans copie du texte)
+inline CsvResult readCsv(const std::string& path, const CsvOptions& options = {}) {
+    MappedFile file(path);
+    return parseCsv(file.data(), file.size(), options);
+}
+
+} // namespace KMeansLib
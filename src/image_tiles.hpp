@@ -0,0 +1,299 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+#include "indexed_image.hpp"
+#include "kmeans_lib.hpp"
+#include "kmeans_stream.hpp"
+
+namespace KMeansLib {
+
+// Quantification par tuiles d'images trop grandes pour être décodées en entier :
+//   1. palette ajustée sur un échantillon stratifié de pixels (stratifiedSample) ;
+//   2. assignation et écriture bande par bande (applyTiled) : les tuiles sont des
+//      bandes de tileRows lignes pleine largeur, traitées en parallèle par
+//      groupes, le groupe suivant étant lu pendant le calcul du groupe courant ;
+//   3. optionnellement, quelques itérations de Lloyd par tuile partant de la
+//      palette globale (couleurs adaptées localement, sortie RVB seulement).
+// La mémoire de travail est bornée par la taille des tuiles, pas par celle de
+// l'image. Les pixels sont en BGR, comme dans OpenCV et les codebooks .kmp.
+
+// Image lue par morceaux
+class ImageSource {
+public:
+    virtual ~ImageSource() = default;
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+    // Copie `count` pixels BGR de la ligne y à partir de la colonne x
+    virtual void read(int y, int x, int count, uint8_t* bgr) = 0;
+};
+
+// Image quantifiée écrite bande par bande, de haut en bas
+class ImageSink {
+public:
+    virtual ~ImageSink() = default;
+    // rows lignes de labels ; palette : couleurs BGR de ces lignes
+    virtual void write(const int* labels, int rows, const PointMatrix& palette) = 0;
+    virtual void close() = 0;
+};
+
+// PPM binaire (P6, 8 bits) lu directement dans le fichier, sans le décoder en
+// entier : chaque lecture est un déplacement suivi d'un fread
+class PpmSource : public ImageSource {
+public:
+    explicit PpmSource(const std::string& path) : path_(path), file_(std::fopen(path.c_str(), "rb")) {
+        if (!file_) throw std::runtime_error("PpmSource: impossible d'ouvrir " + path);
+        int maxValue = 0;
+        if (std::fgetc(file_) != 'P' || std::fgetc(file_) != '6' || !readNumber(width_) || !readNumber(height_) ||
+            !readNumber(maxValue) || maxValue != 255 || width_ <= 0 || height_ <= 0) {
+            std::fclose(file_);
+            throw std::runtime_error("PpmSource: " + path + " n'est pas un PPM binaire (P6) 8 bits");
+        }
+        std::fgetc(file_);   // un seul blanc avant les pixels
+        offset_ = ftello(file_);
+    }
+
+    ~PpmSource() override { std::fclose(file_); }
+
+    PpmSource(const PpmSource&) = delete;
+    PpmSource& operator=(const PpmSource&) = delete;
+
+    int width() const override { return width_; }
+    int height() const override { return height_; }
+
+    void read(int y, int x, int count, uint8_t* bgr) override {
+        const off_t position = offset_ + (static_cast<off_t>(y) * width_ + x) * 3;
+        if (ftello(file_) != position && fseeko(file_, position, SEEK_SET) != 0) fail();
+        if (std::fread(bgr, 3, count, file_) != static_cast<size_t>(count)) fail();
+        for (int i = 0; i < count; ++i) std::swap(bgr[i * 3], bgr[i * 3 + 2]);
+    }
+
+private:
+    // Entier de l'en-tête, blancs et commentaires (#) ignorés
+    bool readNumber(int& value) {
+        int c = std::fgetc(file_);
+        while (c == '#' || std::isspace(c)) {
+            if (c == '#') while (c != '\n' && c != EOF) c = std::fgetc(file_);
+            c = std::fgetc(file_);
+        }
+        if (c == EOF) return false;
+        std::ungetc(c, file_);
+        return std::fscanf(file_, "%d", &value) == 1;
+    }
+
+    [[noreturn]] void fail() { throw std::runtime_error("PpmSource: erreur de lecture " + path_); }
+
+    std::string path_;
+    std::FILE* file_;
+    int width_ = 0, height_ = 0;
+    off_t offset_ = 0;
+};
+
+// PPM binaire écrit au fil des bandes : chaque pixel prend la couleur de son label
+class PpmSink : public ImageSink {
+public:
+    PpmSink(const std::string& path, int width, int height)
+        : path_(path), width_(width), height_(height), file_(std::fopen(path.c_str(), "wb")) {
+        if (!file_) throw std::runtime_error("PpmSink: impossible de créer " + path);
+        std::fprintf(file_, "P6\n%d %d\n255\n", width, height);
+    }
+
+    ~PpmSink() override {
+        if (file_) std::fclose(file_);
+    }
+
+    PpmSink(const PpmSink&) = delete;
+    PpmSink& operator=(const PpmSink&) = delete;
+
+    void write(const int* labels, int rows, const PointMatrix& palette) override {
+        const std::vector<uint8_t> rgb = paletteBytes(palette);
+        std::vector<uint8_t> line(static_cast<size_t>(width_) * 3);
+        for (int y = 0; y < rows; ++y) {
+            for (int x = 0; x < width_; ++x) {
+                std::copy_n(rgb.data() + labels[static_cast<size_t>(y) * width_ + x] * 3, 3, line.data() + x * 3);
+            }
+            if (std::fwrite(line.data(), 1, line.size(), file_) != line.size()) {
+                throw std::runtime_error("PpmSink: erreur d'écriture " + path_);
+            }
+        }
+        written_ += rows;
+    }
+
+    void close() override {
+        if (written_ != height_) throw std::runtime_error("PpmSink: lignes manquantes dans " + path_);
+        const bool failed = std::fclose(file_) != 0;
+        file_ = nullptr;
+        if (failed) throw std::runtime_error("PpmSink: erreur d'écriture " + path_);
+    }
+
+private:
+    std::string path_;
+    int width_, height_;
+    std::FILE* file_;
+    int written_ = 0;
+};
+
+// Image indexée (PNG à palette ou .kmi) écrite au fil des bandes ; la palette
+// est fixée à la construction (pas de raffinement par tuile)
+class IndexedSink : public ImageSink {
+public:
+    IndexedSink(const std::string& path, int width, int height, const PointMatrix& palette)
+        : writer_(path, width, height, palette) {}
+
+    void write(const int* labels, int rows, const PointMatrix&) override { writer_.write(labels, rows); }
+    void close() override { writer_.close(); }
+
+private:
+    IndexedImageWriter writer_;
+};
+
+struct TiledOptions {
+    int tileRows = 256;             // lignes par tuile (bande pleine largeur)
+    size_t sampleSize = 262144;     // pixels de l'échantillon d'ajustement de la palette
+    int strata = 16;                // échantillon stratifié sur une grille strata x strata
+    int refineIterations = 0;       // itérations de Lloyd par tuile (0 = palette globale)
+};
+
+// Mesures de l'étape d'assignation par tuiles
+struct TiledStats {
+    size_t tiles = 0;
+    double cost = 0.0;              // inertie totale (palette de chaque tuile)
+    size_t bufferBytes = 0;         // mémoire des tuiles en vol (pixels et labels)
+    size_t peakResidentBytes = 0;   // pic de mémoire résidente du processus
+    double seconds = 0.0;
+};
+
+// Échantillon stratifié : l'image est découpée en strata x strata cases et
+// chaque case fournit le même nombre de pixels tirés uniformément, pour que
+// les petites régions comptent autant que dans l'image entière. Toute l'image
+// si elle a moins de sampleSize pixels. Les pixels sont lus dans l'ordre du
+// fichier.
+inline PixelMatrix stratifiedSample(ImageSource& source, size_t sampleSize, int strata, uint64_t seed = 0) {
+    const int width = source.width(), height = source.height();
+    const size_t pixels = static_cast<size_t>(width) * height;
+    if (pixels <= sampleSize) {
+        PixelMatrix sample(pixels, 3);
+        for (int y = 0; y < height; ++y) source.read(y, 0, width, sample[static_cast<size_t>(y) * width]);
+        return sample;
+    }
+
+    if (seed == 0) seed = std::random_device{}();
+    std::mt19937_64 rng(seed);
+    const int rowsStrata = std::max(1, std::min(strata, height));
+    const int colsStrata = std::max(1, std::min(strata, width));
+    const size_t perStratum = (sampleSize + rowsStrata * colsStrata - 1) / (rowsStrata * colsStrata);
+    std::vector<size_t> positions;
+    positions.reserve(perStratum * rowsStrata * colsStrata);
+    for (int sy = 0; sy < rowsStrata; ++sy) {
+        const int y0 = static_cast<int>(static_cast<int64_t>(height) * sy / rowsStrata);
+        const int y1 = static_cast<int>(static_cast<int64_t>(height) * (sy + 1) / rowsStrata);
+        for (int sx = 0; sx < colsStrata; ++sx) {
+            const int x0 = static_cast<int>(static_cast<int64_t>(width) * sx / colsStrata);
+            const int x1 = static_cast<int>(static_cast<int64_t>(width) * (sx + 1) / colsStrata);
+            std::uniform_int_distribution<int> row(y0, y1 - 1), col(x0, x1 - 1);
+            for (size_t i = 0; i < perStratum; ++i) {
+                positions.push_back(static_cast<size_t>(row(rng)) * width + col(rng));
+            }
+        }
+    }
+    std::sort(positions.begin(), positions.end());
+
+    PixelMatrix sample(positions.size(), 3);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        source.read(static_cast<int>(positions[i] / width), static_cast<int>(positions[i] % width), 1, sample[i]);
+    }
+    return sample;
+}
+
+// Étapes 2 et 3 : chaque tuile est assignée à la palette (puis raffinée si
+// tiled.refineIterations > 0) et écrite dans sink, dans l'ordre des lignes. Les
+// tuiles d'un groupe (une par thread) sont traitées en parallèle pendant la
+// lecture du groupe suivant : au plus deux groupes de pixels en mémoire.
+inline TiledStats applyTiled(ImageSource& source, ImageSink& sink, const PointMatrix& palette,
+                             const KMeansOptions& options, const TiledOptions& tiled) {
+    if (palette.cols() != 3) throw std::invalid_argument("applyTiled: palette de couleurs (3 canaux) attendue");
+    if (tiled.tileRows <= 0) throw std::invalid_argument("applyTiled: tileRows doit être positif");
+    const auto start = std::chrono::steady_clock::now();
+    const int width = source.width(), height = source.height();
+    const size_t tileCount = (height + tiled.tileRows - 1) / tiled.tileRows;
+
+    ThreadPool pool(options.numThreads);
+    const size_t slots = std::min<size_t>(pool.size(), tileCount);
+    KMeansOptions tileOptions = options;
+    tileOptions.numThreads = 1;   // parallélisme entre tuiles
+    std::vector<std::unique_ptr<KMeans<uint8_t, 3>>> engines;
+    for (size_t s = 0; s < slots; ++s) engines.push_back(std::make_unique<KMeans<uint8_t, 3>>(tileOptions));
+
+    struct Tile {
+        int y = 0, rows = 0;
+        std::vector<uint8_t> pixels;
+        std::vector<int> labels;
+        PointMatrix palette;
+        double cost = 0.0;
+    };
+    auto rowsOf = [&](size_t t) {
+        return std::min(tiled.tileRows, height - static_cast<int>(t) * tiled.tileRows);
+    };
+    auto readGroup = [&](size_t first) {
+        std::vector<Tile> group(std::min(slots, tileCount - first));
+        for (size_t s = 0; s < group.size(); ++s) {
+            Tile& tile = group[s];
+            tile.y = static_cast<int>(first + s) * tiled.tileRows;
+            tile.rows = rowsOf(first + s);
+            tile.pixels.resize(static_cast<size_t>(tile.rows) * width * 3);
+            for (int r = 0; r < tile.rows; ++r) {
+                source.read(tile.y + r, 0, width, tile.pixels.data() + static_cast<size_t>(r) * width * 3);
+            }
+        }
+        return group;
+    };
+
+    TiledStats stats;
+    stats.tiles = tileCount;
+    stats.bufferBytes = 2 * slots * static_cast<size_t>(std::min(tiled.tileRows, height)) * width * 3 +
+                        slots * static_cast<size_t>(std::min(tiled.tileRows, height)) * width * sizeof(int);
+    std::vector<Tile> group = readGroup(0);
+    for (size_t first = 0; first < tileCount; first += slots) {
+        std::future<std::vector<Tile>> next;
+        if (first + slots < tileCount) next = std::async(std::launch::async, readGroup, first + slots);
+
+        pool.parallelFor(group.size(), [&](size_t s) {
+            Tile& tile = group[s];
+            KMeans<uint8_t, 3>& engine = *engines[s];
+            const PixelView view(tile.pixels.data(), static_cast<size_t>(tile.rows) * width, 3);
+            tile.palette = palette;
+            engine.assign(view, tile.palette, tile.labels);
+            if (tiled.refineIterations > 0) {
+                // Couleurs sans pixel dans la tuile : celles de la palette globale
+                engine.update(view, tile.labels, tile.palette);
+                for (int it = 1; it < tiled.refineIterations; ++it) {
+                    if (engine.iterate(view, tile.palette, tile.labels) == 0) break;
+                }
+                engine.assign(view, tile.palette, tile.labels);
+            }
+            tile.cost = engine.cost(view, tile.palette, tile.labels);
+            std::vector<uint8_t>().swap(tile.pixels);
+        });
+        for (Tile& tile : group) {
+            sink.write(tile.labels.data(), tile.rows, tile.palette);
+            stats.cost += tile.cost;
+        }
+        if (next.valid()) group = next.get();
+    }
+    sink.close();
+
+    stats.peakResidentBytes = peakResidentBytes();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+}  // namespace KMeansLib
@@ -0,0 +1,426 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "kmeans_lib.hpp"
+#include "point_file.hpp"
+
+#if defined(KMEANS_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace KMeansLib {
+
+// Image indexée : une palette de K couleurs et, pour chaque pixel, l'indice de
+// sa couleur compacté sur 1, 2, 4 ou 8 bits (le plus petit qui contient K).
+// Chaque ligne commence sur un octet et les indices sont rangés bit de poids
+// fort en premier, comme dans un PNG à palette.
+struct IndexedImage {
+    int width = 0;
+    int height = 0;
+    int bits = 8;                    // bits par indice
+    std::vector<uint8_t> palette;    // couleurs RGB (3 octets chacune)
+    std::vector<uint8_t> indices;    // height lignes de rowBytes() octets
+
+    size_t colors() const { return palette.size() / 3; }
+    size_t rowBytes() const { return (static_cast<size_t>(width) * bits + 7) / 8; }
+
+    int index(int x, int y) const {
+        const uint8_t byte = indices[y * rowBytes() + static_cast<size_t>(x) * bits / 8];
+        const int shift = 8 - bits - static_cast<int>(static_cast<size_t>(x) * bits % 8);
+        return (byte >> shift) & ((1 << bits) - 1);
+    }
+};
+
+// Bits par indice pour une palette de `colors` couleurs (au plus 256)
+inline int indexBits(size_t colors) {
+    if (colors > 256) throw std::invalid_argument("IndexedImage: 256 couleurs au plus");
+    if (colors <= 2) return 1;
+    if (colors <= 4) return 2;
+    if (colors <= 16) return 4;
+    return 8;
+}
+
+// Palette RGB (3 octets par couleur) : centroïdes arrondis, BGR si bgr comme
+// dans OpenCV, RGB sinon
+inline std::vector<uint8_t> paletteBytes(const PointMatrix& centroids, bool bgr = true) {
+    if (centroids.cols() != 3) throw std::invalid_argument("IndexedImage: palette de couleurs (3 canaux) attendue");
+    std::vector<uint8_t> palette(centroids.rows() * 3);
+    for (size_t j = 0; j < centroids.rows(); ++j) {
+        for (int c = 0; c < 3; ++c) {
+            const double value = std::min(255.0, std::max(0.0, std::round(centroids[j][c])));
+            palette[j * 3 + (bgr ? 2 - c : c)] = static_cast<uint8_t>(value);
+        }
+    }
+    return palette;
+}
+
+// Compacte une ligne de `width` labels sur `bits` bits (out : rowBytes octets)
+inline void packIndexRow(const int* labels, int width, int bits, uint8_t* out) {
+    const int perByte = 8 / bits;
+    std::fill(out, out + (static_cast<size_t>(width) * bits + 7) / 8, uint8_t(0));
+    for (int x = 0; x < width; ++x) {
+        const int shift = 8 - bits * (x % perByte + 1);
+        out[x / perByte] |= static_cast<uint8_t>(labels[x] << shift);
+    }
+}
+
+// Palette et labels compactés ; labels[y * width + x] est l'indice du pixel (x, y)
+inline IndexedImage makeIndexedImage(const std::vector<int>& labels, int width, int height,
+                                     const PointMatrix& centroids, bool bgr = true) {
+    if (labels.size() != static_cast<size_t>(width) * height) {
+        throw std::invalid_argument("IndexedImage: un label par pixel attendu");
+    }
+    IndexedImage image;
+    image.width = width;
+    image.height = height;
+    image.bits = indexBits(centroids.rows());
+    image.palette = paletteBytes(centroids, bgr);
+
+    const size_t rowBytes = image.rowBytes();
+    image.indices.resize(rowBytes * height);
+    for (int y = 0; y < height; ++y) {
+        packIndexRow(labels.data() + static_cast<size_t>(y) * width, width, image.bits,
+                     image.indices.data() + y * rowBytes);
+    }
+    return image;
+}
+
+namespace detail {
+
+inline uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline void putBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(value >> shift));
+}
+
+inline void putLittleEndian(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) out.push_back(static_cast<uint8_t>(value >> shift));
+}
+
+inline uint32_t getLittleEndian(const uint8_t* in) {
+    return uint32_t(in[0]) | uint32_t(in[1]) << 8 | uint32_t(in[2]) << 16 | uint32_t(in[3]) << 24;
+}
+
+inline void pngChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+    putBigEndian(out, static_cast<uint32_t>(data.size()));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBigEndian(out, crc32(out.data() + start, out.size() - start));
+}
+
+// Flux zlib des lignes : compressé avec zlib si disponible, sinon en blocs
+// « stockés » (non compressés, mais les indices restent compactés)
+inline std::vector<uint8_t> zlibStream(const std::vector<uint8_t>& raw) {
+#if defined(KMEANS_HAVE_ZLIB)
+    uLongf size = compressBound(static_cast<uLong>(raw.size()));
+    std::vector<uint8_t> out(size);
+    if (compress2(out.data(), &size, raw.data(), static_cast<uLong>(raw.size()), 9) != Z_OK) {
+        throw std::runtime_error("IndexedImage: échec de la compression zlib");
+    }
+    out.resize(size);
+    return out;
+#else
+    std::vector<uint8_t> out = {0x78, 0x01};
+    uint32_t a = 1, b = 0;
+    for (uint8_t byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    size_t offset = 0;
+    do {
+        const size_t block = std::min<size_t>(65535, raw.size() - offset);
+        const bool last = offset + block == raw.size();
+        out.push_back(last ? 1 : 0);
+        out.push_back(static_cast<uint8_t>(block));
+        out.push_back(static_cast<uint8_t>(block >> 8));
+        out.push_back(static_cast<uint8_t>(~block));
+        out.push_back(static_cast<uint8_t>(~block >> 8));
+        out.insert(out.end(), raw.begin() + offset, raw.begin() + offset + block);
+        offset += block;
+    } while (offset < raw.size());
+    putBigEndian(out, (b << 16) | a);
+    return out;
+#endif
+}
+
+inline void writeFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) throw std::runtime_error("IndexedImage: impossible de créer " + path);
+    bool failed = std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size();
+    failed |= std::fclose(file) != 0;
+    if (failed) throw std::runtime_error("IndexedImage: erreur d'écriture " + path);
+}
+
+} // namespace detail
+
+// PNG à palette (type de couleur 3), lisible par tous les logiciels d'images
+inline void writeIndexedPng(const std::string& path, const IndexedImage& image) {
+    std::vector<uint8_t> header;
+    detail::putBigEndian(header, static_cast<uint32_t>(image.width));
+    detail::putBigEndian(header, static_cast<uint32_t>(image.height));
+    header.insert(header.end(), {static_cast<uint8_t>(image.bits), 3, 0, 0, 0});
+
+    // Chaque ligne est précédée de son filtre (0 : aucun)
+    const size_t rowBytes = image.rowBytes();
+    std::vector<uint8_t> raw;
+    raw.reserve((rowBytes + 1) * image.height);
+    for (int y = 0; y < image.height; ++y) {
+        raw.push_back(0);
+        raw.insert(raw.end(), image.indices.begin() + y * rowBytes, image.indices.begin() + (y + 1) * rowBytes);
+    }
+
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    detail::pngChunk(png, "IHDR", header);
+    detail::pngChunk(png, "PLTE", image.palette);
+    detail::pngChunk(png, "IDAT", detail::zlibStream(raw));
+    detail::pngChunk(png, "IEND", {});
+    detail::writeFile(path, png);
+}
+
+// Format compact .kmi, little-endian, sans compression :
+//
+//   octets  0-3   "KMIX"
+//   octets  4-7   version (1)
+//   octets  8-11  largeur
+//   octets 12-15  hauteur
+//   octets 16-19  nombre de couleurs K
+//   octets 20-23  bits par indice (1, 2, 4 ou 8)
+//   octets 24-    palette (K x RGB), puis hauteur lignes d'indices compactés
+constexpr char kIndexedImageMagic[4] = {'K', 'M', 'I', 'X'};
+constexpr uint32_t kIndexedImageVersion = 1;
+constexpr size_t kIndexedImageHeaderSize = 24;
+
+inline void writeIndexedImage(const std::string& path, const IndexedImage& image) {
+    std::vector<uint8_t> bytes(kIndexedImageMagic, kIndexedImageMagic + 4);
+    detail::putLittleEndian(bytes, kIndexedImageVersion);
+    detail::putLittleEndian(bytes, static_cast<uint32_t>(image.width));
+    detail::putLittleEndian(bytes, static_cast<uint32_t>(image.height));
+    detail::putLittleEndian(bytes, static_cast<uint32_t>(image.colors()));
+    detail::putLittleEndian(bytes, static_cast<uint32_t>(image.bits));
+    bytes.insert(bytes.end(), image.palette.begin(), image.palette.end());
+    bytes.insert(bytes.end(), image.indices.begin(), image.indices.end());
+    detail::writeFile(path, bytes);
+}
+
+inline IndexedImage readIndexedImage(const std::string& path) {
+    MappedFile file(path);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(file.data());
+    if (file.size() < kIndexedImageHeaderSize || std::memcmp(data, kIndexedImageMagic, 4) != 0 ||
+        detail::getLittleEndian(data + 4) != kIndexedImageVersion) {
+        throw std::runtime_error("readIndexedImage: " + path + " n'est pas un fichier .kmi v1");
+    }
+    IndexedImage image;
+    image.width = static_cast<int>(detail::getLittleEndian(data + 8));
+    image.height = static_cast<int>(detail::getLittleEndian(data + 12));
+    const size_t colors = detail::getLittleEndian(data + 16);
+    image.bits = static_cast<int>(detail::getLittleEndian(data + 20));
+    if (image.width < 0 || image.height < 0 || colors == 0 || image.bits != indexBits(colors)) {
+        throw std::runtime_error("readIndexedImage: en-tête invalide dans " + path);
+    }
+    const uint8_t* palette = data + kIndexedImageHeaderSize;
+    const uint8_t* indices = palette + colors * 3;
+    if (file.size() < static_cast<size_t>(indices - data) + image.rowBytes() * image.height) {
+        throw std::runtime_error("readIndexedImage: fichier tronqué " + path);
+    }
+    image.palette.assign(palette, indices);
+    image.indices.assign(indices, indices + image.rowBytes() * image.height);
+    return image;
+}
+
+// Écriture d'une image indexée par bandes de lignes, sans la garder en mémoire :
+// PNG à palette si le chemin se termine par .png (flux zlib produit au fil de
+// l'eau, compressé si zlib est disponible), format .kmi sinon. L'en-tête et la
+// palette sont écrits à la construction, close() termine le fichier.
+class IndexedImageWriter {
+public:
+    IndexedImageWriter(const std::string& path, int width, int height, const PointMatrix& centroids,
+                       bool bgr = true)
+        : path_(path), width_(width), height_(height), bits_(indexBits(centroids.rows())),
+          png_(path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0),
+          file_(std::fopen(path.c_str(), "wb")) {
+        if (!file_) throw std::runtime_error("IndexedImage: impossible de créer " + path);
+        const std::vector<uint8_t> palette = paletteBytes(centroids, bgr);
+        std::vector<uint8_t> bytes;
+        if (png_) {
+            std::vector<uint8_t> header;
+            detail::putBigEndian(header, static_cast<uint32_t>(width));
+            detail::putBigEndian(header, static_cast<uint32_t>(height));
+            header.insert(header.end(), {static_cast<uint8_t>(bits_), 3, 0, 0, 0});
+            bytes = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+            detail::pngChunk(bytes, "IHDR", header);
+            detail::pngChunk(bytes, "PLTE", palette);
+#if defined(KMEANS_HAVE_ZLIB)
+            if (deflateInit(&stream_, 6) != Z_OK) throw std::runtime_error("IndexedImage: échec de l'initialisation zlib");
+#else
+            pending_ = {0x78, 0x01};
+#endif
+        } else {
+            bytes.assign(kIndexedImageMagic, kIndexedImageMagic + 4);
+            detail::putLittleEndian(bytes, kIndexedImageVersion);
+            detail::putLittleEndian(bytes, static_cast<uint32_t>(width));
+            detail::putLittleEndian(bytes, static_cast<uint32_t>(height));
+            detail::putLittleEndian(bytes, static_cast<uint32_t>(centroids.rows()));
+            detail::putLittleEndian(bytes, static_cast<uint32_t>(bits_));
+            bytes.insert(bytes.end(), palette.begin(), palette.end());
+        }
+        put(bytes);
+    }
+
+    ~IndexedImageWriter() {
+        if (!file_) return;
+#if defined(KMEANS_HAVE_ZLIB)
+        if (png_) deflateEnd(&stream_);
+#endif
+        std::fclose(file_);
+    }
+
+    IndexedImageWriter(const IndexedImageWriter&) = delete;
+    IndexedImageWriter& operator=(const IndexedImageWriter&) = delete;
+
+    // Lignes suivantes : rows x width labels
+    void write(const int* labels, int rows) {
+        const size_t rowBytes = (static_cast<size_t>(width_) * bits_ + 7) / 8;
+        std::vector<uint8_t> raw(rows * (rowBytes + (png_ ? 1 : 0)));
+        uint8_t* out = raw.data();
+        for (int y = 0; y < rows; ++y) {
+            if (png_) *out++ = 0;   // filtre de ligne : aucun
+            packIndexRow(labels + static_cast<size_t>(y) * width_, width_, bits_, out);
+            out += rowBytes;
+        }
+        written_ += rows;
+        if (png_) compress(raw, false);
+        else put(raw);
+    }
+
+    void close() {
+        if (written_ != height_) throw std::runtime_error("IndexedImage: lignes manquantes dans " + path_);
+        if (png_) {
+            compress({}, true);
+            std::vector<uint8_t> end;
+            detail::pngChunk(end, "IEND", {});
+            put(end);
+        }
+#if defined(KMEANS_HAVE_ZLIB)
+        if (png_) deflateEnd(&stream_);
+#endif
+        const bool failed = std::fclose(file_) != 0;
+        file_ = nullptr;
+        if (failed) throw std::runtime_error("IndexedImage: erreur d'écriture " + path_);
+    }
+
+private:
+    // Taille des chunks IDAT écrits au fil de l'eau
+    static constexpr size_t kChunkBytes = 65535;
+
+    void put(const std::vector<uint8_t>& bytes) {
+        if (std::fwrite(bytes.data(), 1, bytes.size(), file_) != bytes.size()) {
+            throw std::runtime_error("IndexedImage: erreur d'écriture " + path_);
+        }
+    }
+
+    // Ajoute les lignes filtrées au flux zlib ; les octets compressés partent
+    // en chunks IDAT dès qu'il y en a assez (tous à la fin)
+    void compress(const std::vector<uint8_t>& raw, bool finish) {
+#if defined(KMEANS_HAVE_ZLIB)
+        stream_.next_in = const_cast<Bytef*>(raw.data());
+        stream_.avail_in = static_cast<uInt>(raw.size());
+        uint8_t out[16384];
+        int status;
+        do {
+            stream_.next_out = out;
+            stream_.avail_out = sizeof(out);
+            status = deflate(&stream_, finish ? Z_FINISH : Z_NO_FLUSH);
+            if (status == Z_STREAM_ERROR) throw std::runtime_error("IndexedImage: échec de la compression zlib");
+            pending_.insert(pending_.end(), out, out + sizeof(out) - stream_.avail_out);
+        } while (stream_.avail_out == 0 || (finish && status != Z_STREAM_END));
+#else
+        // Blocs « stockés » de 65535 octets, Adler-32 tenu à jour
+        for (uint8_t byte : raw) {
+            adlerA_ = (adlerA_ + byte) % 65521;
+            adlerB_ = (adlerB_ + adlerA_) % 65521;
+        }
+        stored_.insert(stored_.end(), raw.begin(), raw.end());
+        size_t offset = 0;
+        while (stored_.size() - offset >= 65535 || finish) {
+            const size_t block = std::min<size_t>(65535, stored_.size() - offset);
+            const bool last = finish && offset + block == stored_.size();
+            pending_.push_back(last ? 1 : 0);
+            pending_.push_back(static_cast<uint8_t>(block));
+            pending_.push_back(static_cast<uint8_t>(block >> 8));
+            pending_.push_back(static_cast<uint8_t>(~block));
+            pending_.push_back(static_cast<uint8_t>(~block >> 8));
+            pending_.insert(pending_.end(), stored_.begin() + offset, stored_.begin() + offset + block);
+            offset += block;
+            if (last) break;
+        }
+        stored_.erase(stored_.begin(), stored_.begin() + offset);
+        if (finish) detail::putBigEndian(pending_, (adlerB_ << 16) | adlerA_);
+#endif
+        while (pending_.size() >= kChunkBytes || (finish && !pending_.empty())) {
+            const size_t size = std::min(kChunkBytes, pending_.size());
+            std::vector<uint8_t> chunk;
+            detail::pngChunk(chunk, "IDAT", std::vector<uint8_t>(pending_.begin(), pending_.begin() + size));
+            put(chunk);
+            pending_.erase(pending_.begin(), pending_.begin() + size);
+        }
+    }
+
+    std::string path_;
+    int width_, height_, bits_;
+    bool png_;
+    std::FILE* file_;
+    int written_ = 0;
+    std::vector<uint8_t> pending_;   // flux zlib pas encore écrit
+#if defined(KMEANS_HAVE_ZLIB)
+    z_stream stream_{};
+#else
+    std::vector<uint8_t> stored_;    // lignes pas encore mises en bloc
+    uint32_t adlerA_ = 1, adlerB_ = 0;
+#endif
+};
+
+// PNG à palette si le chemin se termine par .png, format .kmi sinon
+inline void saveIndexedImage(const std::string& path, const IndexedImage& image) {
+    const bool png = path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0;
+    if (png) writeIndexedPng(path, image);
+    else writeIndexedImage(path, image);
+}
+
+// Codebook : les centroïdes d'un K-means, enregistrés dans un fichier .kmp
+// (float64) pour quantifier d'autres données par assignation seule
+inline void saveCodebook(const std::string& path, const PointMatrix& centroids) {
+    PointFileWriter writer(path, centroids.cols(), PointType::Float64);
+    for (size_t j = 0; j < centroids.rows(); ++j) writer.append(centroids[j]);
+    writer.close();
+}
+
+inline PointMatrix loadCodebook(const std::string& path) {
+    MappedPointFile file(path);
+    PointMatrix centroids(file.count(), file.dims());
+    file.read(centroids.data(), file.count());
+    if (centroids.empty()) throw std::runtime_error("loadCodebook: aucun centroïde dans " + path);
+    return centroids;
+}
+
+} // namespace KMeansLib
@@ -0,0 +1,392 @@
+// ============================================================================
+// Benchmarks des noyaux de kmeans_lib.hpp (Google Benchmark)
+// ============================================================================
+// Balayages autour d'une configuration de base (N = 1e5, K = 16, dimension 3) :
+// N de 1e3 à 1e8, K de 2 à 1024, dimension 2, 3, 16 et 128. Les cas dont les
+// données dépassent --max-bytes sont ignorés.
+//
+//   ./kmeans_bench --threads=0 --benchmark_out=bench.json --benchmark_out_format=json
+//
+// Compteurs : items_per_second (points/s), bytes_per_second (octets de points
+// lus), kmeans_iterations (itérations de K-means effectuées ; distinct du champ
+// iterations de Google Benchmark, le nombre d'exécutions mesurées).
+// ============================================================================
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "kmeans_lib.hpp"
+#include "kmeans_online.hpp"
+#include "kmeans_sweep.hpp"
+
+using namespace KMeansLib;
+
+namespace {
+
+int gThreads = 1;                          // --threads=N (0 = tous les coeurs)
+size_t gMaxBytes = size_t(1) << 30;        // --max-bytes=B : taille max des données
+
+// Points gaussiens autour de 32 centres, générés une seule fois par (N, dim)
+const PointMatrix& syntheticPoints(size_t n, size_t dims) {
+    static std::map<std::pair<size_t, size_t>, std::unique_ptr<PointMatrix>> cache;
+    auto& slot = cache[{n, dims}];
+    if (!slot) {
+        std::mt19937_64 rng(42);
+        std::normal_distribution<double> noise(0.0, 1.0);
+        std::uniform_real_distribution<double> center(0.0, 100.0);
+        PointMatrix centers(32, dims);
+        for (size_t i = 0; i < centers.rows() * dims; ++i) centers.data()[i] = center(rng);
+
+        slot.reset(new PointMatrix(n, dims));
+        for (size_t i = 0; i < n; ++i) {
+            const double* c = centers.row(rng() % centers.rows());
+            double* p = slot->row(i);
+            for (size_t d = 0; d < dims; ++d) p[d] = c[d] + 5.0 * noise(rng);
+        }
+    }
+    return *slot;
+}
+
+// Image BGR synthétique comme create_test_image.cpp : fond blanc et quatre
+// quadrants rouge / vert / bleu / jaune, avec un dégradé et du bruit pour que
+// les couleurs ne soient pas toutes identiques
+std::vector<uint8_t> syntheticImage(int width, int height) {
+    static const uint8_t quadrants[4][3] = {{0, 0, 255}, {0, 255, 0}, {255, 0, 0}, {0, 255, 255}};
+    std::vector<uint8_t> image(static_cast<size_t>(width) * height * 3);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> noise(-12, 12);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const uint8_t* color = quadrants[(y * 2 / height) * 2 + (x * 2 / width)];
+            int shade = (x + y) * 64 / (width + height);
+            uint8_t* pixel = &image[(static_cast<size_t>(y) * width + x) * 3];
+            for (int c = 0; c < 3; ++c) {
+                pixel[c] = static_cast<uint8_t>(std::clamp(color[c] - shade + noise(rng), 0, 255));
+            }
+        }
+    }
+    return image;
+}
+
+void setThroughput(benchmark::State& state, size_t points, size_t dims) {
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * points));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * points * dims * sizeof(double)));
+}
+
+// ---------------------------------------------------------------------------
+// Noyaux
+// ---------------------------------------------------------------------------
+
+void BM_DistanceSquared(benchmark::State& state, size_t n, size_t dims) {
+    const PointMatrix& points = syntheticPoints(n, dims);
+    const double* centroid = points.row(0);
+    for (auto _ : state) {
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) sum += distanceSquared(points.row(i), centroid, dims);
+        benchmark::DoNotOptimize(sum);
+    }
+    setThroughput(state, n, dims);
+}
+
+void BM_FindClosestCentroids(benchmark::State& state, size_t n, int k, size_t dims) {
+    const PointMatrix& points = syntheticPoints(n, dims);
+    PointMatrix centroids = initializeCentroids(points.view(), k, 1);
+    ThreadPool pool(gThreads);
+    AssignmentKernel kernel;
+    std::vector<int> assignments;
+    for (auto _ : state) {
+        findClosestCentroids(points, centroids, assignments, pool, kernel);
+        benchmark::DoNotOptimize(assignments.data());
+    }
+    setThroughput(state, n, dims);
+    state.SetLabel(simdLevelName(kernel.level()));
+}
+
+void BM_ComputeCentroids(benchmark::State& state, size_t n, int k, size_t dims) {
+    const PointMatrix& points = syntheticPoints(n, dims);
+    PointMatrix initial = initializeCentroids(points.view(), k, 1);
+    ThreadPool pool(gThreads);
+    std::vector<int> assignments;
+    findClosestCentroids(points, initial, assignments, pool);
+    for (auto _ : state) {
+        PointMatrix centroids = computeCentroids(points, assignments, k, pool);
+        benchmark::DoNotOptimize(centroids.data());
+    }
+    setThroughput(state, n, dims);
+}
+
+void BM_Seeding(benchmark::State& state, SeedingMethod method, size_t n, int k, size_t dims) {
+    const PointMatrix& points = syntheticPoints(n, dims);
+    KMeansOptions options;
+    options.seed = 1;
+    options.numThreads = gThreads;
+    options.seeding = method;
+    KMeans<double> engine(options);
+    for (auto _ : state) {
+        PointMatrix centroids = engine.initialize(points.view(), k);
+        benchmark::DoNotOptimize(centroids.data());
+    }
+    setThroughput(state, n, dims);
+}
+
+void BM_KMeans(benchmark::State& state, KMeansAlgorithm algorithm, size_t n, int k, size_t dims) {
+    const PointMatrix& points = syntheticPoints(n, dims);
+    KMeansOptions options;
+    options.seed = 1;
+    options.maxIterations = 20;
+    options.numThreads = gThreads;
+    options.algorithm = algorithm;
+    int iterations = 0;
+    for (auto _ : state) {
+        KMeansResult result = kmeans(points, k, options);
+        iterations = result.iterations;
+        benchmark::DoNotOptimize(result.finalCost);
+    }
+    setThroughput(state, n, dims);
+    state.counters["kmeans_iterations"] = iterations;
+}
+
+// Quantification complète : pixels -> points, K-means, palette -> pixels
+void BM_ImageQuantization(benchmark::State& state, int width, int height, int k) {
+    const std::vector<uint8_t> image = syntheticImage(width, height);
+    const size_t pixels = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> output(image.size());
+    KMeansOptions options;
+    options.seed = 1;
+    options.maxIterations = 20;
+    options.numThreads = gThreads;
+    int iterations = 0;
+    for (auto _ : state) {
+        PointMatrix points(pixels, 3);
+        for (size_t i = 0; i < pixels * 3; ++i) points.data()[i] = image[i];
+        KMeansResult result = kmeans(points, k, options);
+        for (size_t i = 0; i < pixels; ++i) {
+            const double* color = result.centroids[result.assignments[i]];
+            for (int c = 0; c < 3; ++c) output[i * 3 + c] = static_cast<uint8_t>(color[c] + 0.5);
+        }
+        iterations = result.iterations;
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * pixels));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * image.size()));
+    state.counters["kmeans_iterations"] = iterations;
+}
+
+// Même quantification sur les pixels 8 bits lus en place (KMeans<uint8_t, 3>) :
+// pas de copie en double, distances en double ou en float32
+void BM_ImageQuantizationUInt8(benchmark::State& state, int width, int height, int k, bool float32) {
+    const std::vector<uint8_t> image = syntheticImage(width, height);
+    const size_t pixels = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> output(image.size());
+    KMeansOptions options;
+    options.seed = 1;
+    options.maxIterations = 20;
+    options.numThreads = gThreads;
+    options.useFloat32 = float32;
+    int iterations = 0;
+    for (auto _ : state) {
+        KMeansResult result = kmeans(PixelView(image.data(), pixels, 3), k, options);
+        for (size_t i = 0; i < pixels; ++i) {
+            const double* color = result.centroids[result.assignments[i]];
+            for (int c = 0; c < 3; ++c) output[i * 3 + c] = static_cast<uint8_t>(color[c] + 0.5);
+        }
+        iterations = result.iterations;
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * pixels));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * image.size()));
+    state.counters["kmeans_iterations"] = iterations;
+}
+
+// Assignation seule à une grande palette (quantification par un codebook) :
+// parcours des K centroïdes ou grille de centroïdes (CentroidIndex::Grid)
+void BM_PaletteAssignment(benchmark::State& state, int width, int height, int k, CentroidIndex index) {
+    const std::vector<uint8_t> image = syntheticImage(width, height);
+    const size_t pixels = static_cast<size_t>(width) * height;
+    const PixelView view(image.data(), pixels, 3);
+    KMeansOptions options;
+    options.numThreads = gThreads;
+    options.centroidIndex = index;
+    KMeans<uint8_t, 3> engine(options);
+    const PointMatrix palette = initializeCentroids(view, k, 1);
+    std::vector<int> assignments;
+    for (auto _ : state) {
+        engine.assign(view, palette, assignments);
+        benchmark::DoNotOptimize(assignments.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * pixels));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * image.size()));
+}
+
+// Balayage de K = 2 à 64 (courbe complète, critère du coude) : chaque K repart
+// des clusters coupés du K précédent, ou d'une nouvelle initialisation (cold)
+void BM_KSweep(benchmark::State& state, size_t n, bool warm) {
+    const PointMatrix& points = syntheticPoints(n, 3);
+    KMeansOptions options;
+    options.numThreads = gThreads;
+    options.seed = 1;
+    options.changedTolerance = 0.001;
+    KSweepOptions sweep;
+    sweep.minK = 2;
+    sweep.maxK = 64;
+    int iterations = 0;
+    for (auto _ : state) {
+        iterations = 0;
+        if (warm) {
+            KSweepResult result = sweepK(points.view(), options, sweep);
+            for (const KSweepPoint& p : result.curve) iterations += p.iterations;
+            benchmark::DoNotOptimize(result.chosenK);
+        } else {
+            for (int k = sweep.minK; k <= sweep.maxK; ++k) {
+                KMeansResult result = kmeans(points, k, options);
+                iterations += result.iterations;
+                benchmark::DoNotOptimize(result.finalCost);
+            }
+        }
+    }
+    state.counters["kmeans_iterations"] = iterations;
+}
+
+const size_t kOnlinePoints = 1000000;
+
+// K-means en ligne : un point ajouté par itération du banc (latence = 1 /
+// items_per_second), après une consolidation tous les 100000 points
+void BM_OnlineAdd(benchmark::State& state, int k, size_t dims) {
+    const PointMatrix& points = syntheticPoints(kOnlinePoints, dims);
+    OnlineKMeans<> online(k, dims);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(online.add(points.row(i)));
+        if (++i == points.rows()) i = 0;
+        if (i % 100000 == 0) online.consolidate();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// ---------------------------------------------------------------------------
+// Enregistrement des balayages
+// ---------------------------------------------------------------------------
+
+const size_t kBaseN = 100000;
+const int kBaseK = 16;
+const size_t kBaseDims = 3;
+
+// Configurations (N, K, dim) : trois balayages autour de la configuration de base
+std::vector<std::tuple<size_t, int, size_t>> sweep() {
+    std::vector<std::tuple<size_t, int, size_t>> configs;
+    for (size_t n = 1000; n <= 100000000; n *= 10) configs.emplace_back(n, kBaseK, kBaseDims);
+    for (int k : {2, 8, 64, 256, 1024}) configs.emplace_back(kBaseN, k, kBaseDims);
+    for (size_t dims : {2, 16, 128}) configs.emplace_back(kBaseN, kBaseK, dims);
+
+    std::vector<std::tuple<size_t, int, size_t>> kept;
+    for (const auto& config : configs) {
+        if (std::get<0>(config) * std::get<2>(config) * sizeof(double) <= gMaxBytes) kept.push_back(config);
+    }
+    return kept;
+}
+
+// Les cas d'au moins kSingleRunPoints points (plusieurs secondes) ne sont
+// exécutés qu'une fois ; les autres gardent le nombre d'exécutions choisi par
+// Google Benchmark
+const size_t kSingleRunPoints = 1000000;
+
+benchmark::internal::Benchmark* singleRunIfLarge(benchmark::internal::Benchmark* bench, size_t points) {
+    return points >= kSingleRunPoints ? bench->Iterations(1) : bench;
+}
+
+std::string caseName(const char* name, size_t n, int k, size_t dims) {
+    return std::string(name) + "/N:" + std::to_string(n) + "/K:" + std::to_string(k) +
+           "/dim:" + std::to_string(dims);
+}
+
+void registerBenchmarks() {
+    for (size_t dims : {2, 3, 16, 128}) {
+        benchmark::RegisterBenchmark(("BM_DistanceSquared/dim:" + std::to_string(dims)).c_str(),
+                                     BM_DistanceSquared, kBaseN, dims);
+    }
+
+    for (const auto& [n, k, dims] : sweep()) {
+        if (static_cast<size_t>(k) > n) continue;
+        benchmark::RegisterBenchmark(caseName("BM_FindClosestCentroids", n, k, dims).c_str(),
+                                     BM_FindClosestCentroids, n, k, dims)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(caseName("BM_ComputeCentroids", n, k, dims).c_str(),
+                                     BM_ComputeCentroids, n, k, dims)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(caseName("BM_Seeding/kmeans++", n, k, dims).c_str(),
+                                     BM_Seeding, SeedingMethod::KMeansPlusPlus, n, k, dims)
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(caseName("BM_Seeding/kmeans||", n, k, dims).c_str(),
+                                     BM_Seeding, SeedingMethod::KMeansParallel, n, k, dims)
+            ->Unit(benchmark::kMillisecond);
+        singleRunIfLarge(benchmark::RegisterBenchmark(caseName("BM_KMeans/Lloyd", n, k, dims).c_str(),
+                                                      BM_KMeans, KMeansAlgorithm::Lloyd, n, k, dims)
+                             ->Unit(benchmark::kMillisecond), n);
+        singleRunIfLarge(benchmark::RegisterBenchmark(caseName("BM_KMeans/Auto", n, k, dims).c_str(),
+                                                      BM_KMeans, KMeansAlgorithm::Auto, n, k, dims)
+                             ->Unit(benchmark::kMillisecond), n);
+    }
+
+    for (auto [width, height] : {std::pair<int, int>{200, 200}, {640, 480}, {1920, 1080}, {3840, 2160}}) {
+        for (int k : {8, 64}) {
+            std::string name = "BM_ImageQuantization/" + std::to_string(width) + "x" +
+                               std::to_string(height) + "/K:" + std::to_string(k);
+            const size_t pixels = static_cast<size_t>(width) * height;
+            singleRunIfLarge(benchmark::RegisterBenchmark(name.c_str(), BM_ImageQuantization, width, height, k)
+                                 ->Unit(benchmark::kMillisecond), pixels);
+            singleRunIfLarge(benchmark::RegisterBenchmark((name + "/uint8").c_str(), BM_ImageQuantizationUInt8,
+                                                          width, height, k, false)
+                                 ->Unit(benchmark::kMillisecond), pixels);
+            singleRunIfLarge(benchmark::RegisterBenchmark((name + "/uint8-float32").c_str(),
+                                                          BM_ImageQuantizationUInt8, width, height, k, true)
+                                 ->Unit(benchmark::kMillisecond), pixels);
+        }
+    }
+
+    for (int k : {16, 256}) {
+        benchmark::RegisterBenchmark(("BM_OnlineAdd/K:" + std::to_string(k) + "/dim:3").c_str(),
+                                     BM_OnlineAdd, k, size_t(3));
+    }
+
+    for (bool warm : {false, true}) {
+        benchmark::RegisterBenchmark(warm ? "BM_KSweep/N:100000/K:2-64/warm" : "BM_KSweep/N:100000/K:2-64/cold",
+                                     BM_KSweep, kBaseN, warm)
+            ->Unit(benchmark::kMillisecond)->Iterations(1);
+    }
+
+    for (int k : {256, 1024, 4096}) {
+        std::string name = "BM_PaletteAssignment/1920x1080/K:" + std::to_string(k);
+        benchmark::RegisterBenchmark((name + "/linear").c_str(), BM_PaletteAssignment,
+                                     1920, 1080, k, CentroidIndex::None)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark((name + "/grid").c_str(), BM_PaletteAssignment,
+                                     1920, 1080, k, CentroidIndex::Grid)->Unit(benchmark::kMillisecond);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    // Options propres au banc, après celles de Google Benchmark
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--threads=", 10) == 0) {
+            gThreads = std::atoi(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--max-bytes=", 12) == 0) {
+            gMaxBytes = std::strtoull(argv[i] + 12, nullptr, 10);
+        } else {
+            std::fprintf(stderr, "Option inconnue: %s\n", argv[i]);
+            std::fprintf(stderr, "Options: --threads=N (0 = tous les coeurs) --max-bytes=B + options --benchmark_*\n");
+            return 1;
+        }
+    }
+
+    registerBenchmarks();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,111 @@
+// Conversion CSV -> fichier de points binaire .kmp (voir point_file.hpp)
+//
+//   kmeans_convert points.csv points.kmp --type float32 --header
+//
+// Chaque ligne contient les coordonnées d'un point, séparées par des virgules
+// (--delimiter pour un autre séparateur). Avec --weights-column N, la colonne N
+// (à partir de 0) est retirée des coordonnées et enregistrée comme poids du point.
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "csv_reader.hpp"
+#include "point_file.hpp"
+
+using namespace std;
+using namespace KMeansLib;
+
+bool parseType(const string& name, PointType& type) {
+    if (name == "float64") type = PointType::Float64;
+    else if (name == "float32") type = PointType::Float32;
+    else if (name == "uint8") type = PointType::UInt8;
+    else return false;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <input.csv> <output.kmp> [--type float64|float32|uint8]"
+             << " [--weights-column N] [--header] [--delimiter C] [--threads N]\n";
+        cerr << "  --type: coordinate type in the output file (default: float64)\n";
+        cerr << "  --weights-column: column holding the point weight (0-based)\n";
+        cerr << "  --header: skip the first line\n";
+        cerr << "  --delimiter: field separator, 'tab' for tabs (default: ,)\n";
+        cerr << "  --threads: parser threads, 0 = all cores (default: 0)\n";
+        return 1;
+    }
+
+    string inputPath = argv[1];
+    string outputPath = argv[2];
+    PointType type = PointType::Float64;
+    int weightsColumn = -1;
+    CsvOptions csv;
+    csv.numThreads = 0;
+    for (int i = 3; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--type" && i + 1 < argc) {
+            if (!parseType(argv[++i], type)) {
+                cerr << "Erreur: type inconnu " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--weights-column" && i + 1 < argc) {
+            weightsColumn = stoi(argv[++i]);
+        } else if (arg == "--header") {
+            csv.skipHeader = true;
+        } else if (arg == "--delimiter" && i + 1 < argc) {
+            string delimiter = argv[++i];
+            csv.delimiter = (delimiter == "tab") ? '\t' : delimiter[0];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            csv.numThreads = stoi(argv[++i]);
+        } else {
+            cerr << "Erreur: option inconnue " << arg << "\n";
+            return 1;
+        }
+    }
+
+    try {
+        auto start = chrono::steady_clock::now();
+        CsvResult parsed = readCsv(inputPath, csv);
+        double parseSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        const PointMatrix& values = parsed.points;
+
+        if (parsed.malformedLines) {
+            cout << "Lignes ignorées (mal formées): " << parsed.malformedLines << " (lignes";
+            for (size_t line : parsed.malformedSamples) cout << " " << line;
+            cout << (parsed.malformedLines > parsed.malformedSamples.size() ? " ...)\n" : ")\n");
+        }
+        if (values.empty()) {
+            cerr << "Erreur: aucun point valide dans " << inputPath << "\n";
+            return 1;
+        }
+        // La colonne des poids doit exister et laisser au moins une coordonnée
+        if (weightsColumn >= 0 && (weightsColumn >= static_cast<int>(values.cols()) || values.cols() < 2)) {
+            cerr << "Erreur: " << inputPath << " n'a que " << values.cols() << " colonnes\n";
+            return 1;
+        }
+
+        const size_t dims = values.cols() - (weightsColumn >= 0 ? 1 : 0);
+        PointFileWriter writer(outputPath, dims, type, weightsColumn >= 0);
+        vector<double> point(dims);
+        for (size_t i = 0; i < values.rows(); ++i) {
+            const double* row = values.row(i);
+            if (weightsColumn < 0) {
+                writer.append(row);
+                continue;
+            }
+            copy(row, row + weightsColumn, point.begin());
+            copy(row + weightsColumn + 1, row + values.cols(), point.begin() + weightsColumn);
+            writer.append(point.data(), row[weightsColumn]);
+        }
+        writer.close();
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << values.rows() << " points (dimension " << dims << ", " << pointTypeName(type)
+             << (weightsColumn >= 0 ? ", pondérés" : "") << ") -> " << outputPath << " en "
+             << seconds << " s (lecture CSV: " << parseSeconds << " s)\n";
+    } catch (const exception& e) {
+        cerr << "Erreur: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,63 +1,600 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "image_tiles.hpp"
+#include "indexed_image.hpp"
 #include "kmeans_lib.hpp"
+#include "kmeans_opencv.hpp"
+#include "kmeans_sweep.hpp"
 
 using namespace std;
 using namespace cv;
 using namespace KMeansLib;
 
-// Convertit une image OpenCV en matrice de points pour K-means
-Matrix imageToPoints(const Mat& image) {
-    Matrix points;
-    points.reserve(image.rows * image.cols);
-    
+// Histogramme des couleurs : une entrée par couleur BGR distincte (ou par case
+// après troncature des bits de poids faible), pondérée par son nombre de pixels.
+// K-means tourne sur les entrées pondérées : sans troncature, même résultat que
+// sur les pixels, avec souvent 10 à 100 fois moins de points.
+struct ColorHistogram {
+    PointMatrix colors;               // couleur moyenne de chaque entrée (BGR)
+    vector<double> counts;            // nombre de pixels de chaque entrée
+    vector<uint32_t> pixelEntries;    // entrée de chaque pixel
+};
+
+ColorHistogram buildColorHistogram(const Mat& image, int bits) {
+    const int shift = 8 - bits;
+    ColorHistogram histogram;
+    histogram.pixelEntries.resize(static_cast<size_t>(image.rows) * image.cols);
+
+    unordered_map<uint32_t, uint32_t> entries;  // clé BGR tronquée -> entrée
+    vector<double> sums;
+    uint32_t lastKey = UINT32_MAX, lastEntry = 0;
+    size_t pixel = 0;
     for (int i = 0; i < image.rows; ++i) {
-        for (int j = 0; j < image.cols; ++j) {
-            Vec3b pixel = image.at<Vec3b>(i, j);
-            points.push_back({
-                static_cast<double>(pixel[0]), // B
-                static_cast<double>(pixel[1]), // G
-                static_cast<double>(pixel[2])  // R
-            });
+        const Vec3b* row = image.ptr<Vec3b>(i);
+        for (int j = 0; j < image.cols; ++j, ++pixel) {
+            const Vec3b& bgr = row[j];
+            uint32_t key = (uint32_t(bgr[0] >> shift) << 16) | (uint32_t(bgr[1] >> shift) << 8) |
+                           uint32_t(bgr[2] >> shift);
+            // Les pixels voisins ont souvent la même couleur : on évite le hachage
+            if (key != lastKey) {
+                auto inserted = entries.try_emplace(key, static_cast<uint32_t>(histogram.counts.size()));
+                if (inserted.second) {
+                    histogram.counts.push_back(0.0);
+                    sums.insert(sums.end(), 3, 0.0);
+                }
+                lastKey = key;
+                lastEntry = inserted.first->second;
+            }
+            histogram.counts[lastEntry] += 1.0;
+            for (int c = 0; c < 3; ++c) sums[lastEntry * 3 + c] += bgr[c];
+            histogram.pixelEntries[pixel] = lastEntry;
         }
     }
-    return points;
+
+    histogram.colors = PointMatrix(histogram.counts.size(), 3);
+    for (size_t e = 0; e < histogram.counts.size(); ++e) {
+        for (int c = 0; c < 3; ++c) histogram.colors[e][c] = sums[e * 3 + c] / histogram.counts[e];
+    }
+    return histogram;
 }
 
-// Convertit les points K-means en image OpenCV
-Mat pointsToImage(const Matrix& centroids, const vector<int>& assignments, 
-                  int rows, int cols) {
-    Mat result(rows, cols, CV_8UC3);
-    
-    int pointIndex = 0;
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            int cluster = assignments[pointIndex++];
-            const auto& centroid = centroids[cluster];
-            
-            result.at<Vec3b>(i, j) = Vec3b(
-                static_cast<uchar>(round(centroid[0])), // B
-                static_cast<uchar>(round(centroid[1])), // G
-                static_cast<uchar>(round(centroid[2]))  // R
-            );
+// Quantification d'une image : palette (centroïdes BGR) et label de chaque pixel
+struct Quantization {
+    PointMatrix palette;
+    vector<int> labels;
+    double cost = 0.0;
+};
+
+// Labels par pixel à partir des labels par entrée de l'histogramme
+vector<int> expandHistogramLabels(const ColorHistogram& histogram, const vector<int>& entryLabels) {
+    vector<int> labels(histogram.pixelEntries.size());
+    for (size_t p = 0; p < labels.size(); ++p) labels[p] = entryLabels[histogram.pixelEntries[p]];
+    return labels;
+}
+
+// Assignation seule à un codebook déjà entraîné (--codebook) : une passe de
+// recherche du centroïde le plus proche, sans itérations ni mise à jour
+template <typename T>
+KMeansResult assignToCodebook(const BasicPointView<T>& points, const PointMatrix& codebook,
+                              const KMeansOptions& options, const vector<double>& weights = {}) {
+    KMeans<T, 3> engine(options);
+    KMeansResult result;
+    result.centroids = codebook;
+    engine.assign(points, codebook, result.assignments);
+    result.finalCost = engine.cost(points, codebook, result.assignments, weights);
+    return result;
+}
+
+// Écrit le résultat : image BGR classique, ou image indexée (palette et indices
+// compactés : PNG à palette si le chemin finit par .png, .kmi sinon)
+void writeQuantized(const string& path, const Quantization& quantization, int rows, int cols,
+                    bool indexed, int threads) {
+    if (indexed) {
+        saveIndexedImage(path, makeIndexedImage(quantization.labels, cols, rows, quantization.palette));
+    } else if (!imwrite(path, labelsToImage(quantization.labels, quantization.palette, rows, cols, threads))) {
+        throw runtime_error("Impossible de sauvegarder l'image " + path);
+    }
+}
+
+// PSNR (dB) d'une quantification à partir de son coût (somme des erreurs carrées)
+double psnrFromCost(double cost, size_t pixels) {
+    double mse = cost / (3.0 * pixels);
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+}
+
+// ---------------------------------------------------------------------------
+// Mode lot (--batch) : décodage, K-means et encodage en pipeline
+// ---------------------------------------------------------------------------
+
+bool isImageFile(const filesystem::path& path) {
+    string ext = path.extension().string();
+    transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return tolower(c); });
+    return ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp" ||
+           ext == ".tif" || ext == ".tiff" || ext == ".webp";
+}
+
+// Images d'un dossier (triées par nom) ou d'un fichier liste (un chemin par ligne)
+vector<string> listImages(const string& input) {
+    vector<string> paths;
+    if (filesystem::is_directory(input)) {
+        for (const auto& entry : filesystem::directory_iterator(input)) {
+            if (entry.is_regular_file() && isImageFile(entry.path())) paths.push_back(entry.path().string());
+        }
+        sort(paths.begin(), paths.end());
+    } else {
+        ifstream list(input);
+        string line;
+        while (getline(list, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) paths.push_back(line);
         }
     }
-    return result;
+    return paths;
+}
+
+// Quantifie une image : mêmes étapes que le mode image unique, sans affichage.
+// Avec un codebook, les couleurs sont seulement assignées à sa palette ; avec
+// un balayage, K est choisi pour chaque image.
+Quantization quantizeImage(const Mat& image, int k, const KMeansOptions& options, int histogramBits,
+                           const PointMatrix* codebook, const KSweepOptions* sweep) {
+    KMeansResult result;
+    if (histogramBits > 0) {
+        ColorHistogram histogram = buildColorHistogram(image, histogramBits);
+        if (codebook) result = assignToCodebook(histogram.colors.view(), *codebook, options, histogram.counts);
+        else if (sweep) result = sweepK(histogram.colors, options, *sweep, histogram.counts).best;
+        else result = kmeans(histogram.colors, k, options, histogram.counts);
+        return {move(result.centroids), expandHistogramLabels(histogram, result.assignments), result.finalCost};
+    }
+    MatPixels pixels(image);
+    if (codebook) result = assignToCodebook(pixels.view(), *codebook, options);
+    else if (sweep) result = sweepK(pixels.view(), options, *sweep).best;
+    else result = kmeans(pixels.view(), k, options);
+    return {move(result.centroids), move(result.assignments), result.finalCost};
+}
+
+struct BatchItem {
+    size_t index = 0;
+    Mat image;
+    Quantization quantization;
+};
+
+// Temps cumulé d'une étape (sur tous ses threads)
+struct StageTimer {
+    atomic<int64_t> nanoseconds{0};
+
+    template <typename Fn>
+    auto measure(Fn&& fn) {
+        auto start = chrono::steady_clock::now();
+        auto value = fn();
+        nanoseconds += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        return value;
+    }
+
+    double seconds() const { return nanoseconds.load() * 1e-9; }
+};
+
+// Trois étapes reliées par des files bornées : des threads de décodage lisent
+// les images suivantes pendant que les threads K-means traitent les courantes,
+// puis des threads d'encodage écrivent les résultats. Chaque image est
+// quantifiée sur un seul thread : avec beaucoup de petites images, le
+// parallélisme entre images est bien meilleur qu'à l'intérieur d'une image.
+int runBatch(const string& input, const string& outputDir, int k, KMeansOptions options,
+             int histogramBits, int threads, size_t queueSize, const PointMatrix* codebook, bool indexed,
+             const KSweepOptions* sweep) {
+    const vector<string> paths = listImages(input);
+    if (paths.empty()) {
+        cerr << "Erreur: aucune image trouvée dans " << input << "\n";
+        return 1;
+    }
+
+    // Sorties dans output_dir sous le nom de l'image : deux entrées de même nom
+    // (dossiers différents d'une liste, ou x.jpg et x.png avec --indexed)
+    // s'écraseraient, le lot est refusé avant de commencer
+    vector<string> outputs;
+    map<string, size_t> outputIndex;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        filesystem::path output = filesystem::path(outputDir) / filesystem::path(paths[i]).filename();
+        if (indexed) output.replace_extension(".png");
+        auto [it, inserted] = outputIndex.emplace(output.string(), i);
+        if (!inserted) {
+            cerr << "Erreur: " << paths[it->second] << " et " << paths[i] << " seraient écrites dans le même fichier "
+                 << output.string() << "\n";
+            return 1;
+        }
+        outputs.push_back(output.string());
+    }
+    filesystem::create_directories(outputDir);
+
+    if (threads <= 0) threads = static_cast<int>(max(1u, thread::hardware_concurrency()));
+    const int clusterThreads = threads;
+    const int ioThreads = max(1, threads / 4);
+    options.numThreads = 1;
+    setNumThreads(1);  // pas de threads OpenCV en plus de ceux du pipeline
+
+    cout << paths.size() << " images, "
+         << (codebook ? "codebook de " + to_string(codebook->rows()) + " couleurs"
+             : sweep ? "K choisi par image (" + to_string(sweep->minK) + " à " + to_string(sweep->maxK) + ")"
+             : "K=" + to_string(k))
+         << ", " << clusterThreads << " threads K-means, "
+         << ioThreads << " threads de décodage et " << ioThreads << " d'encodage, files de "
+         << queueSize << " images\n";
+
+    BoundedQueue<BatchItem> decoded(queueSize);
+    BoundedQueue<BatchItem> quantized(queueSize);
+    StageTimer decodeTime, clusterTime, encodeTime;
+    atomic<size_t> next{0}, failures{0}, done{0};
+    mutex logMutex;
+    auto fail = [&](const string& message) {
+        lock_guard<mutex> lock(logMutex);
+        cerr << "Erreur: " << message << "\n";
+        ++failures;
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> decoders, clusterers, encoders;
+    for (int t = 0; t < ioThreads; ++t) {
+        decoders.emplace_back([&] {
+            for (size_t i = next++; i < paths.size(); i = next++) {
+                Mat image = decodeTime.measure([&] { return imread(paths[i], IMREAD_COLOR); });
+                if (image.empty()) {
+                    fail("Impossible de charger l'image " + paths[i]);
+                    continue;
+                }
+                decoded.push({i, move(image), {}});
+            }
+        });
+    }
+    for (int t = 0; t < clusterThreads; ++t) {
+        clusterers.emplace_back([&] {
+            BatchItem item;
+            while (decoded.pop(item)) {
+                try {
+                    item.quantization = clusterTime.measure([&] {
+                        return quantizeImage(item.image, k, options, histogramBits, codebook, sweep);
+                    });
+                } catch (const exception& e) {
+                    fail(paths[item.index] + ": " + e.what());
+                    continue;
+                }
+                quantized.push(move(item));
+            }
+        });
+    }
+    for (int t = 0; t < ioThreads; ++t) {
+        encoders.emplace_back([&] {
+            BatchItem item;
+            while (quantized.pop(item)) {
+                try {
+                    encodeTime.measure([&] {
+                        writeQuantized(outputs[item.index], item.quantization, item.image.rows, item.image.cols, indexed, 1);
+                        return true;
+                    });
+                } catch (const exception& e) {
+                    fail(e.what());
+                    continue;
+                }
+                ++done;
+            }
+        });
+    }
+
+    // Chaque file est fermée quand tous ses producteurs ont terminé
+    for (auto& worker : decoders) worker.join();
+    decoded.close();
+    for (auto& worker : clusterers) worker.join();
+    quantized.close();
+    for (auto& worker : encoders) worker.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    const double images = max<size_t>(1, done.load());
+    cout << done << " images quantifiées en " << seconds << " s (" << done / seconds << " images/s)";
+    if (failures) cout << ", " << failures << " échecs";
+    cout << "\nTemps par étape (cumulé sur les threads, moyenne par image):\n";
+    cout << "  décodage: " << decodeTime.seconds() << " s (" << 1000.0 * decodeTime.seconds() / images << " ms)\n";
+    cout << "  K-means:  " << clusterTime.seconds() << " s (" << 1000.0 * clusterTime.seconds() / images << " ms)\n";
+    cout << "  encodage: " << encodeTime.seconds() << " s (" << 1000.0 * encodeTime.seconds() / images << " ms)\n";
+    return failures ? 1 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Mode tuiles (--tiled) : images trop grandes pour être décodées en mémoire
+// ---------------------------------------------------------------------------
+
+string lowerExtension(const string& path) {
+    string ext = filesystem::path(path).extension().string();
+    transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return tolower(c); });
+    return ext;
+}
+
+// Image décodée en entier par OpenCV (formats autres que PPM) : seules les
+// étapes suivant le décodage sont alors bornées par la taille des tuiles
+class MatImageSource : public ImageSource {
+public:
+    explicit MatImageSource(Mat image) : image_(move(image)) {}
+
+    int width() const override { return image_.cols; }
+    int height() const override { return image_.rows; }
+
+    void read(int y, int x, int count, uint8_t* bgr) override {
+        const uint8_t* row = image_.ptr<uint8_t>(y) + static_cast<size_t>(x) * 3;
+        copy(row, row + static_cast<size_t>(count) * 3, bgr);
+    }
+
+private:
+    Mat image_;
+};
+
+// Palette ajustée sur un échantillon stratifié (ou lue dans le codebook), puis
+// assignation et écriture tuile par tuile. Les PPM binaires sont lus et écrits
+// par bandes : la mémoire ne dépend que de la largeur et de la hauteur des tuiles.
+int runTiled(const string& inputPath, const string& outputPath, int k, const KMeansOptions& options,
+             const TiledOptions& tiled, const PointMatrix* codebook, const KSweepOptions* sweep,
+             const string& saveCodebookPath) {
+    const string inputExt = lowerExtension(inputPath), outputExt = lowerExtension(outputPath);
+    const bool indexed = outputExt == ".png" || outputExt == ".kmi";
+    if (!indexed && outputExt != ".ppm" && outputExt != ".pnm") {
+        cerr << "Erreur: --tiled écrit une image .ppm, ou indexée .png / .kmi (K <= 256)\n";
+        return 1;
+    }
+    if (indexed && tiled.refineIterations > 0) {
+        cerr << "Erreur: --refine donne une palette par tuile, sortie .ppm attendue\n";
+        return 1;
+    }
+
+    unique_ptr<ImageSource> source;
+    try {
+        if (inputExt == ".ppm" || inputExt == ".pnm") {
+            source = make_unique<PpmSource>(inputPath);
+        } else {
+            Mat image = imread(inputPath, IMREAD_COLOR);
+            if (image.empty()) {
+                cerr << "Erreur: Impossible de charger l'image " << inputPath << "\n";
+                return 1;
+            }
+            cout << "Format non PPM: image décodée en entier par OpenCV\n";
+            source = make_unique<MatImageSource>(move(image));
+        }
+    } catch (const exception& e) {
+        cerr << "Erreur: " << e.what() << "\n";
+        return 1;
+    }
+    const size_t pixels = static_cast<size_t>(source->width()) * source->height();
+    cout << "Image: " << source->width() << "x" << source->height() << " (" << pixels
+         << " pixels), tuiles de " << tiled.tileRows << " lignes\n";
+
+    // 1. Palette globale
+    auto start = chrono::steady_clock::now();
+    KMeansResult result;
+    size_t sampled = 0;
+    if (codebook) {
+        result.centroids = *codebook;
+    } else {
+        PixelMatrix sample = stratifiedSample(*source, tiled.sampleSize, tiled.strata, options.seed);
+        sampled = sample.rows();
+        if (sweep) {
+            KSweepOptions range = *sweep;
+            if (indexed) range.maxK = min(range.maxK, 256);
+            KSweepResult swept = sweepK(sample.view(), options, range);
+            cout << "K choisi sur l'échantillon: " << swept.chosenK << "\n";
+            result = move(swept.best);
+        } else {
+            result = kmeans(sample.view(), k, options);
+        }
+    }
+    if (indexed && result.centroids.rows() > 256) {
+        cerr << "Erreur: une image indexée a au plus 256 couleurs\n";
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (!codebook) {
+        cout << "Palette: " << result.centroids.rows() << " couleurs ajustées sur " << sampled
+             << " pixels échantillonnés (" << seconds << " s)\n";
+    }
+    if (!saveCodebookPath.empty() && !codebook) {
+        saveCodebook(saveCodebookPath, result.centroids);
+        cout << "Codebook sauvegardé: " << saveCodebookPath << "\n";
+    }
+
+    // 2. et 3. Assignation (et raffinement) par tuiles, écriture au fil de l'eau
+    TiledStats stats;
+    try {
+        unique_ptr<ImageSink> sink;
+        if (indexed) sink = make_unique<IndexedSink>(outputPath, source->width(), source->height(), result.centroids);
+        else sink = make_unique<PpmSink>(outputPath, source->width(), source->height());
+        stats = applyTiled(*source, *sink, result.centroids, options, tiled);
+    } catch (const exception& e) {
+        cerr << "Erreur: " << e.what() << "\n";
+        return 1;
+    }
+    cout << stats.tiles << " tuiles traitées en " << stats.seconds << " s";
+    if (tiled.refineIterations > 0) cout << " (jusqu'à " << tiled.refineIterations << " itérations par tuile)";
+    cout << "\nCoût final: " << stats.cost << " (PSNR " << psnrFromCost(stats.cost, pixels) << " dB)\n";
+    cout << "Mémoire des tuiles: " << stats.bufferBytes / 1048576.0 << " Mo, pic résident: "
+         << stats.peakResidentBytes / 1048576.0 << " Mo\n";
+    cout << (indexed ? "Image indexée sauvegardée: " : "Image compressée sauvegardée: ") << outputPath << "\n";
+    return 0;
 }
 
 int main(int argc, char** argv) {
-    if (argc < 4) {
-        cerr << "Usage: " << argv[0] << " <input_image> <output_image> <K> [max_iterations]\n";
-        cerr << "  K: number of colors (clusters)\n";
+    // Options nommées (--batch-size, --compare) puis arguments positionnels
+    vector<string> positional;
+    size_t batchSize = 0;
+    bool compare = false;
+    KMeansOptions options;
+    options.centroidIndex = CentroidIndex::Auto;
+    int histogramBits = 8;
+    bool batch = false;
+    bool tiledMode = false;
+    TiledOptions tiled;
+    size_t queueSize = 16;
+    string statsPath;
+    string codebookPath, saveCodebookPath;
+    bool indexed = false;
+    KSweepOptions sweep;
+    bool sweeping = false, rangeGiven = false;
+    string curvePath;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (parseStoppingOption(argc, argv, i, options)) {
+            continue;
+        } else if (arg == "--batch-size" && i + 1 < argc) {
+            batchSize = stoul(argv[++i]);
+        } else if (arg == "--compare") {
+            compare = true;
+        } else if (arg == "--init" && i + 1 < argc) {
+            string method = argv[++i];
+            if (method == "kmeans++") options.seeding = SeedingMethod::KMeansPlusPlus;
+            else if (method == "kmeans||") options.seeding = SeedingMethod::KMeansParallel;
+            else options.seeding = SeedingMethod::Random;
+        } else if (arg == "--histogram-bits" && i + 1 < argc) {
+            histogramBits = max(1, min(8, stoi(argv[++i])));
+        } else if (arg == "--no-histogram") {
+            histogramBits = 0;
+        } else if (arg == "--batch") {
+            batch = true;
+        } else if (arg == "--tiled") {
+            tiledMode = true;
+        } else if (arg == "--tile-rows" && i + 1 < argc) {
+            tiled.tileRows = max(1, stoi(argv[++i]));
+        } else if (arg == "--sample" && i + 1 < argc) {
+            tiled.sampleSize = max<size_t>(1, stoul(argv[++i]));
+        } else if (arg == "--refine" && i + 1 < argc) {
+            tiled.refineIterations = max(0, stoi(argv[++i]));
+        } else if (arg == "--queue-size" && i + 1 < argc) {
+            queueSize = stoul(argv[++i]);
+        } else if (arg == "--float32") {
+            options.useFloat32 = true;
+        } else if (arg == "--stats" && i + 1 < argc) {
+            statsPath = argv[++i];
+
+        } else if (arg == "--k-range" && i + 1 < argc) {
+            // MIN:MAX[:STEP]
+            string range = argv[++i];
+            size_t first = range.find(':'), second = range.find(':', first + 1);
+            try {
+                sweep.minK = max(1, stoi(range.substr(0, first)));
+                sweep.maxK = stoi(range.substr(first + 1, second - first - 1));
+                if (second != string::npos) sweep.step = max(1, stoi(range.substr(second + 1)));
+            } catch (const exception&) {
+                cerr << "Erreur: --k-range attend MIN:MAX[:STEP], reçu " << range << "\n";
+                return 1;
+            }
+            sweeping = rangeGiven = true;
+        } else if (arg == "--select" && i + 1 < argc) {
+            string criterion = argv[++i];
+            if (criterion == "silhouette") sweep.selection = KSelection::Silhouette;
+            else if (criterion == "psnr") sweep.selection = KSelection::Psnr;
+            else sweep.selection = KSelection::Elbow;
+            sweeping = true;
+        } else if (arg == "--target-psnr" && i + 1 < argc) {
+            sweep.targetPsnr = stod(argv[++i]);
+            sweep.selection = KSelection::Psnr;
+            sweeping = true;
+        } else if (arg == "--sweep-curve" && i + 1 < argc) {
+            curvePath = argv[++i];
+        } else if (arg == "--no-grid") {
+            options.centroidIndex = CentroidIndex::None;
+        } else if (arg == "--indexed") {
+            indexed = true;
+        } else if (arg == "--codebook" && i + 1 < argc) {
+            codebookPath = argv[++i];
+        } else if (arg == "--save-codebook" && i + 1 < argc) {
+            saveCodebookPath = argv[++i];
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() < (codebookPath.empty() && !sweeping ? 3u : 2u)) {
+        cerr << "Usage: " << argv[0] << " [--batch-size N] [--compare] [--init M] [--histogram-bits B | --no-histogram] [--float32] <input_image> <output_image> <K> [max_iterations] [threads]\n";
+        cerr << "       " << argv[0] << " --codebook FILE.kmp [options] <input_image> <output_image> [K] [max_iterations] [threads]\n";
+        cerr << "       " << argv[0] << " --batch [--queue-size N] [options] <input_dir|list.txt> <output_dir> <K> [max_iterations] [threads]\n";
+        cerr << "       " << argv[0] << " --tiled [--tile-rows N] [--sample N] [--refine N] [options] <input_image> <output.ppm|.png|.kmi> <K> [max_iterations] [threads]\n";
+        cerr << "       " << argv[0] << " --target-psnr DB | --k-range MIN:MAX[:STEP] [--select C] [options] <input_image> <output_image> [K] [max_iterations] [threads]\n";
+        cerr << "  K: number of colors (clusters), ignored with --codebook, --k-range or --target-psnr\n";
         cerr << "  max_iterations: maximum iterations (default: 20)\n";
+        cerr << "  threads: worker threads, 0 = all cores (default: 0)\n";
+        cerr << "  --batch-size N: mini-batch K-means with N pixels per batch (default: full Lloyd)\n";
+        cerr << "  --compare: with --batch-size, also run full Lloyd and report the accuracy loss\n";
+        cerr << "  --init M: seeding, random | kmeans++ | kmeans|| (default: random)\n";
+        cerr << "  --histogram-bits B: cluster unique colors truncated to B bits per channel (default: 8 = exact)\n";
+        cerr << "  --no-histogram: cluster every pixel independently\n";
+        cerr << "  --float32: compute assignment distances in float32 (faster, may differ on near ties)\n";
+        cerr << "  --batch: quantize every image of a directory (or listed in a text file) into output_dir\n";
+        cerr << "  --queue-size N: with --batch, images buffered between pipeline stages (default: 16)\n";
+        cerr << "  --tiled: huge images, palette fitted on a stratified pixel sample then applied tile by tile; PPM input and output are streamed, .png/.kmi output is indexed\n";
+        cerr << "  --tile-rows N: with --tiled, rows per tile (default: 256)\n";
+        cerr << "  --sample N: with --tiled, pixels sampled to fit the palette (default: 262144)\n";
+        cerr << "  --refine N: with --tiled, up to N Lloyd iterations per tile from the global palette (.ppm output, default: 0)\n";
+        cerr << "  --stats FILE: write per-iteration timings and counters (.json, otherwise CSV)\n";
+        printStoppingUsage(cerr);
+        cerr << "  --k-range MIN:MAX[:STEP]: sweep K, each K warm-started by splitting the previous K's largest clusters (default: 2:32, 2:256 with --target-psnr)\n";
+        cerr << "  --select C: sweep criterion, elbow | silhouette | psnr (default: elbow)\n";
+        cerr << "  --target-psnr DB: smallest K whose quantization reaches DB dB (sweep stops there)\n";
+        cerr << "  --sweep-curve FILE.csv: write the cost curve of the sweep\n";
+        cerr << "  --no-grid: compare every pixel to all K colors (default: centroid grid when K >= 128, same result)\n";
+        cerr << "  --indexed: write a palette image, indexed PNG if the output ends in .png, compact .kmi otherwise (K <= 256)\n";
+        cerr << "  --save-codebook FILE.kmp: save the fitted palette for later runs with --codebook\n";
+        cerr << "  --codebook FILE.kmp: reuse a saved palette, assignment only (no K-means iterations)\n";
         return 1;
     }
     
-    string inputPath = argv[1];
-    string outputPath = argv[2];
-    int k = stoi(argv[3]);
-    int maxIterations = (argc >= 5) ? stoi(argv[4]) : 20;
+    string inputPath = positional[0];
+    string outputPath = positional[1];
+    int k = (positional.size() >= 3) ? stoi(positional[2]) : 0;
+    options.maxIterations = (positional.size() >= 4) ? stoi(positional[3]) : 20;
+    int threads = (positional.size() >= 5) ? stoi(positional[4]) : 0;
+    options.numThreads = threads;
+    if (batchSize > 0) {
+        options.algorithm = KMeansAlgorithm::MiniBatch;
+        options.batchSize = batchSize;
+    }
+    if (outputPath.size() >= 4 && outputPath.compare(outputPath.size() - 4, 4, ".kmi") == 0) indexed = true;
+
+    // Palette entraînée auparavant (--save-codebook) : assignation seule
+    PointMatrix codebook;
+    if (!codebookPath.empty()) {
+        try {
+            codebook = loadCodebook(codebookPath);
+        } catch (const exception& e) {
+            cerr << "Erreur: " << e.what() << "\n";
+            return 1;
+        }
+        if (codebook.cols() != 3) {
+            cerr << "Erreur: le codebook " << codebookPath << " doit contenir des couleurs BGR (3 dimensions)\n";
+            return 1;
+        }
+        k = static_cast<int>(codebook.rows());
+        cout << "Codebook chargé: " << k << " couleurs (" << codebookPath << ")\n";
+    }
+    const PointMatrix* palette = codebook.empty() ? nullptr : &codebook;
+    sweeping = sweeping && !palette;
+    if (sweeping && !rangeGiven && sweep.selection == KSelection::Psnr) sweep.maxK = 256;
+    if (sweeping && indexed) sweep.maxK = min(sweep.maxK, 256);   // palette indexée : 256 couleurs au plus
+
+    if (batch) {
+        return runBatch(inputPath, outputPath, k, options, histogramBits, threads, queueSize, palette, indexed,
+                        sweeping ? &sweep : nullptr);
+    }
     
+    if (tiledMode) {
+        return runTiled(inputPath, outputPath, k, options, tiled, palette, sweeping ? &sweep : nullptr,
+                        saveCodebookPath);
+    }
+
     // Charger l'image
     Mat image = imread(inputPath, IMREAD_COLOR);
     if (image.empty()) {
@@ -67,33 +604,126 @@ int main(int argc, char** argv) {
     
     cout << "Image chargée: " << image.cols << "x" << image.rows 
          << " (" << (image.rows * image.cols) << " pixels)\n";
-    cout << "Compression avec K=" << k << " couleurs...\n";
+    if (sweeping) {
+        cout << "Balayage de K=" << sweep.minK << " à " << sweep.maxK << " (noyau "
+             << simdLevelName(resolveSimdLevel(SimdLevel::Auto)) << ")...\n";
+    } else {
+        cout << (palette ? "Assignation" : "Compression") << " avec K=" << k << " couleurs (noyau "
+             << simdLevelName(resolveSimdLevel(SimdLevel::Auto)) << ")...\n";
+    }
     
-    // Convertir l'image en points 3D (RGB)
-    Matrix points = imageToPoints(image);
+    // Points 3D (BGR) : couleurs distinctes pondérées, ou un point par pixel lu
+    // en place dans l'image
+    const size_t pixels = static_cast<size_t>(image.rows) * image.cols;
+    ColorHistogram histogram;
+    MatPixels pixelPoints(image);
+    if (histogramBits > 0) {
+        histogram = buildColorHistogram(image, histogramBits);
+        cout << "Histogramme: " << histogram.colors.rows() << " couleurs distinctes"
+             << (histogramBits < 8 ? " (tronquées à " + to_string(histogramBits) + " bits)" : string())
+             << ", " << static_cast<double>(pixels) / histogram.colors.rows() << "x moins de points\n";
+    }
+    auto cluster = [&](const KMeansOptions& clusterOptions) {
+        if (palette) {
+            return histogramBits > 0
+                ? assignToCodebook(histogram.colors.view(), *palette, clusterOptions, histogram.counts)
+                : assignToCodebook(pixelPoints.view(), *palette, clusterOptions);
+        }
+        return histogramBits > 0 ? kmeans(histogram.colors, k, clusterOptions, histogram.counts)
+                                 : kmeans(pixelPoints.view(), k, clusterOptions);
+    };
     
     // Exécuter K-means
-    auto result = kmeans(points, k, maxIterations);
-    
-    cout << "K-means terminé après " << result.iterations << " iterations\n";
-    cout << "Coût final: " << result.finalCost << "\n";
+    options.collectStats = !statsPath.empty();
+    auto start = chrono::steady_clock::now();
+    KSweepResult sweepResult;
+    if (sweeping) {
+        sweepResult = histogramBits > 0 ? sweepK(histogram.colors, options, sweep, histogram.counts)
+                                        : sweepK(pixelPoints.view(), options, sweep);
+    }
+    auto result = sweeping ? move(sweepResult.best) : cluster(options);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
     
-    // Reconstruire l'image avec les couleurs quantifiées
-    Mat compressedImage = pointsToImage(result.centroids, result.assignments,
-                                       image.rows, image.cols);
+    if (palette) {
+        cout << "Assignation au codebook terminée (" << seconds << " s)\n";
+    } else if (sweeping) {
+        cout << "Balayage terminé (" << seconds << " s):\n";
+        cout << "      K       inertie   PSNR (dB)" << (sweep.selection == KSelection::Silhouette ? "  silhouette" : "")
+             << "  itérations\n";
+        for (const KSweepPoint& p : sweepResult.curve) {
+            cout << setw(7) << p.k << setw(14) << p.inertia << setw(12) << fixed << setprecision(2) << p.psnr;
+            if (sweep.selection == KSelection::Silhouette) cout << setw(12) << setprecision(3) << p.silhouette;
+            cout << defaultfloat << setprecision(6) << setw(12) << p.iterations << (p.k == sweepResult.chosenK ? "  <-" : "") << "\n";
+        }
+        k = sweepResult.chosenK;
+        cout << "K choisi: " << k;
+        if (sweep.selection == KSelection::Psnr) {
+            cout << (sweepResult.targetReached ? " (PSNR cible " : " (PSNR cible non atteinte, ")
+                 << sweep.targetPsnr << " dB)";
+        }
+        cout << "\n";
+        if (!curvePath.empty()) {
+            ofstream curve(curvePath);
+            writeSweepCsv(curve, sweepResult.curve);
+            cout << "Courbe de coût: " << curvePath << "\n";
+        }
+    } else if (batchSize > 0) {
+        cout << "K-means mini-batch terminé après " << result.iterations
+             << " mini-batchs de " << batchSize << " pixels (" << seconds << " s)\n";
+    } else {
+        cout << "K-means terminé après " << result.iterations << " iterations (" << seconds << " s)\n";
+    }
+    if (!palette && options.numInit > 1) {
+        cout << "Relances: " << options.numInit << ", meilleure gardée (" << result.restartsAbandoned
+             << " abandonnées en cours de route)\n";
+    }
+    cout << "Coût final: " << result.finalCost
+         << " (PSNR " << psnrFromCost(result.finalCost, pixels) << " dB)\n";
+    if (!statsPath.empty()) {
+        saveStats(statsPath, result.stats);
+        cout << "Mesures par itération: " << statsPath << "\n";
+    }
+
+    // Référence Lloyd complète sur la même image, même initialisation
+    if (batchSize > 0 && compare && !palette && !sweeping) {
+        KMeansOptions fullOptions = options;
+        fullOptions.algorithm = KMeansAlgorithm::Lloyd;
+        fullOptions.collectStats = false;
+        start = chrono::steady_clock::now();
+        auto full = cluster(fullOptions);
+        double fullSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Lloyd complet: coût " << full.finalCost
+             << " (PSNR " << psnrFromCost(full.finalCost, pixels) << " dB, "
+             << fullSeconds << " s)\n";
+        cout << "Écart mini-batch / Lloyd: "
+             << 100.0 * (result.finalCost / full.finalCost - 1.0) << " % de coût, "
+             << psnrFromCost(result.finalCost, pixels) - psnrFromCost(full.finalCost, pixels)
+             << " dB, accélération x" << fullSeconds / seconds << "\n";
+    }
     
-    // Sauvegarder l'image compressée
-    if (!imwrite(outputPath, compressedImage)) {
-        cerr << "Erreur: Impossible de sauvegarder l'image " << outputPath << "\n";
+    if (!saveCodebookPath.empty() && !palette) {
+        saveCodebook(saveCodebookPath, result.centroids);
+        cout << "Codebook sauvegardé: " << saveCodebookPath << "\n";
+    }
+
+    // Reconstruire et sauvegarder l'image avec les couleurs quantifiées
+    Quantization quantization{result.centroids,
+                              histogramBits > 0 ? expandHistogramLabels(histogram, result.assignments)
+                                                : result.assignments,
+                              result.finalCost};
+    try {
+        writeQuantized(outputPath, quantization, image.rows, image.cols, indexed, threads);
+    } catch (const exception& e) {
+        cerr << "Erreur: " << e.what() << "\n";
         return 1;
     }
     
-    cout << "Image compressée sauvegardée: " << outputPath << "\n";
+    cout << (indexed ? "Image indexée sauvegardée: " : "Image compressée sauvegardée: ") << outputPath << "\n";
     
     // Afficher les couleurs finales
     cout << "\nCouleurs finales (BGR):\n";
     for (size_t i = 0; i < result.centroids.size(); ++i) {
-        const auto& c = result.centroids[i];
+        const double* c = result.centroids[i];
         cout << "  Couleur " << i << ": (" 
              << static_cast<int>(c[0]) << ", "
              << static_cast<int>(c[1]) << ", "
@@ -5,136 +5,1732 @@
 #include <random>
 #include <limits>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_set>
+#include <queue>
+#include <functional>
+#include <utility>
+#include <chrono>
+#include "thread_pool.hpp"
+#include "centroid_grid.hpp"
+#include "kmeans_simd.hpp"
+#include "kmeans_stats.hpp"
 
 namespace KMeansLib {
 
 using Vector = std::vector<double>;
 using Matrix = std::vector<Vector>;
 
+// Vue non-propriétaire sur des points stockés ligne par ligne dans un buffer dense.
+// `stride` = écart (en éléments) entre deux lignes ; il permet de pointer directement
+// dans un buffer existant (ex: les données d'un cv::Mat CV_64FC3) sans copie.
+template <typename T>
+class BasicPointView {
+public:
+    BasicPointView() = default;
+    BasicPointView(const T* data, size_t rows, size_t cols, size_t stride = 0)
+        : data_(data), rows_(rows), cols_(cols), stride_(stride ? stride : cols) {}
+
+    const T* row(size_t i) const { return data_ + i * stride_; }
+    const T* operator[](size_t i) const { return row(i); }
+
+    const T* data() const { return data_; }
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    size_t stride() const { return stride_; }
+    size_t size() const { return rows_; }
+    bool empty() const { return rows_ == 0; }
+
+    // Sous-ensemble de lignes [begin, begin + count)
+    BasicPointView slice(size_t begin, size_t count) const {
+        return BasicPointView(row(begin), count, cols_, stride_);
+    }
+
+private:
+    const T* data_ = nullptr;
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+    size_t stride_ = 0;
+};
+
+using PointView = BasicPointView<double>;
+using PixelView = BasicPointView<uint8_t>;
+
+// Poids des points (un double par point, vide = poids 1) sans copie : pointe
+// dans un std::vector existant ou directement dans un fichier projeté (.kmp)
+class WeightView {
+public:
+    WeightView() = default;
+    WeightView(const std::vector<double>& weights) : data_(weights.data()), size_(weights.size()) {}
+    WeightView(const double* data, size_t size) : data_(data), size_(size) {}
+
+    const double& operator[](size_t i) const { return data_[i]; }
+    const double* data() const { return data_; }
+    const double* begin() const { return data_; }
+    const double* end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    const double* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Matrice de points propriétaire : un seul buffer contigu (rows x cols)
+// au lieu d'une allocation par point comme avec Matrix.
+// T = uint8_t (PixelMatrix) garde les pixels 8 bits tels quels : 1 octet par
+// canal au lieu de 8, et le moteur KMeans<uint8_t, Dim> les lit directement.
+template <typename T>
+class BasicPointMatrix {
+public:
+    BasicPointMatrix() = default;
+    BasicPointMatrix(size_t rows, size_t cols, T value = T())
+        : data_(rows * cols, value), rows_(rows), cols_(cols) {}
+
+    // Copie depuis l'ancien format vector<vector<double>>
+    explicit BasicPointMatrix(const Matrix& points)
+        : rows_(points.size()), cols_(points.empty() ? 0 : points[0].size()) {
+        data_.resize(rows_ * cols_);
+        for (size_t i = 0; i < rows_; ++i) {
+            std::copy(points[i].begin(), points[i].begin() + cols_, row(i));
+        }
+    }
+
+    // Copie d'une vue (éventuellement avec stride) dans un buffer compact
+    explicit BasicPointMatrix(const BasicPointView<T>& view)
+        : data_(view.rows() * view.cols()), rows_(view.rows()), cols_(view.cols()) {
+        for (size_t i = 0; i < rows_; ++i) {
+            std::copy(view.row(i), view.row(i) + cols_, row(i));
+        }
+    }
+
+    T* row(size_t i) { return data_.data() + i * cols_; }
+    const T* row(size_t i) const { return data_.data() + i * cols_; }
+    T* operator[](size_t i) { return row(i); }
+    const T* operator[](size_t i) const { return row(i); }
+
+    T* data() { return data_.data(); }
+    const T* data() const { return data_.data(); }
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    size_t size() const { return rows_; }
+    bool empty() const { return rows_ == 0; }
+
+    BasicPointView<T> view() const { return BasicPointView<T>(data_.data(), rows_, cols_); }
+    operator BasicPointView<T>() const { return view(); }
+
+    // Change le nombre de lignes ; les lignes conservées gardent leurs valeurs
+    void resize(size_t rows) {
+        data_.resize(rows * cols_);
+        rows_ = rows;
+    }
+
+    // Conversion vers l'ancien format (pour l'affichage ou le code legacy)
+    Matrix toRows() const {
+        Matrix out(rows_);
+        for (size_t i = 0; i < rows_; ++i) {
+            out[i].assign(row(i), row(i) + cols_);
+        }
+        return out;
+    }
+
+private:
+    std::vector<T> data_;
+    size_t rows_ = 0;
+    size_t cols_ = 0;
+};
+
+using PointMatrix = BasicPointMatrix<double>;
+using PixelMatrix = BasicPointMatrix<uint8_t>;
+
 // Distance euclidienne au carré (plus rapide)
-inline double distanceSquared(const Vector& a, const Vector& b) {
+inline double distanceSquared(const double* a, const double* b, size_t dimensions) {
     double sum = 0.0;
-    for (size_t i = 0; i < a.size(); ++i) {
+    for (size_t i = 0; i < dimensions; ++i) {
         double diff = a[i] - b[i];
         sum += diff * diff;
     }
     return sum;
 }
 
+inline double distanceSquared(const Vector& a, const Vector& b) {
+    return distanceSquared(a.data(), b.data(), a.size());
+}
+
 // Distance euclidienne
 inline double distance(const Vector& a, const Vector& b) {
     return std::sqrt(distanceSquared(a, b));
 }
 
-// Trouve les centroïdes les plus proches pour chaque point
-std::vector<int> findClosestCentroids(const Matrix& points, const Matrix& centroids) {
-    std::vector<int> assignments(points.size());
-    
-    for (size_t i = 0; i < points.size(); ++i) {
-        double bestDistance = std::numeric_limits<double>::infinity();
-        int bestCentroid = 0;
-        
-        for (size_t j = 0; j < centroids.size(); ++j) {
-            double dist = distanceSquared(points[i], centroids[j]);
-            if (dist < bestDistance) {
-                bestDistance = dist;
-                bestCentroid = static_cast<int>(j);
+// Distance au carré avec une dimension fixée à la compilation (boucle déroulée
+// pour Dim = 2, 3, 4...) ; Dim = Dynamic utilise `dimensions`.
+template <int Dim, typename T>
+inline double distanceSquaredFixed(const T* a, const double* b, size_t dimensions) {
+    const size_t dims = Dim != Dynamic ? Dim : dimensions;
+    double sum = 0.0;
+    for (size_t i = 0; i < dims; ++i) {
+        double diff = static_cast<double>(a[i]) - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Découpage des points en blocs pour le parallélisme. La taille des blocs ne dépend
+// que du nombre de points (jamais du nombre de threads) : les sommes partielles sont
+// donc toujours les mêmes et fusionnées dans le même ordre, ce qui rend le résultat
+// identique au bit près quel que soit le nombre de threads.
+constexpr size_t kMaxChunks = 64;
+constexpr size_t kMinChunkSize = 4096;
+
+inline size_t chunkCount(size_t n) {
+    size_t chunks = (n + kMinChunkSize - 1) / kMinChunkSize;
+    return std::max<size_t>(1, std::min(chunks, kMaxChunks));
+}
+
+// Appelle fn(chunk, begin, end) pour chaque bloc, réparti sur le pool
+template <typename Fn>
+void forEachChunk(ThreadPool& pool, size_t n, Fn&& fn) {
+    const size_t chunks = chunkCount(n);
+    const size_t chunkSize = (n + chunks - 1) / chunks;
+    pool.parallelFor(chunks, [&](size_t c) {
+        size_t begin = std::min(n, c * chunkSize);
+        size_t end = std::min(n, begin + chunkSize);
+        fn(c, begin, end);
+    });
+}
+
+// Boîte englobante des points (lo / hi : une valeur par dimension), calculée
+// par blocs en parallèle
+template <typename T>
+void pointBounds(const BasicPointView<T>& points, ThreadPool& pool, double* lo, double* hi) {
+    const size_t dims = points.cols();
+    std::vector<double> partial(chunkCount(points.rows()) * dims * 2);
+    forEachChunk(pool, points.rows(), [&](size_t c, size_t begin, size_t end) {
+        double* chunkLo = &partial[c * dims * 2];
+        double* chunkHi = chunkLo + dims;
+        std::fill(chunkLo, chunkLo + dims, std::numeric_limits<double>::infinity());
+        std::fill(chunkHi, chunkHi + dims, -std::numeric_limits<double>::infinity());
+        for (size_t i = begin; i < end; ++i) {
+            const T* point = points.row(i);
+            for (size_t d = 0; d < dims; ++d) {
+                chunkLo[d] = std::min(chunkLo[d], static_cast<double>(point[d]));
+                chunkHi[d] = std::max(chunkHi[d], static_cast<double>(point[d]));
             }
         }
-        assignments[i] = bestCentroid;
+    });
+    std::fill(lo, lo + dims, std::numeric_limits<double>::infinity());
+    std::fill(hi, hi + dims, -std::numeric_limits<double>::infinity());
+    for (size_t c = 0; c < partial.size() / (dims * 2); ++c) {
+        for (size_t d = 0; d < dims; ++d) {
+            lo[d] = std::min(lo[d], partial[c * dims * 2 + d]);
+            hi[d] = std::max(hi[d], partial[c * dims * 2 + dims + d]);
+        }
     }
+}
+
+// Trouve les centroïdes les plus proches pour chaque point.
+// Le noyau (scalaire, AVX2 ou AVX-512) compare chaque point à un bloc de
+// centroïdes transposé ; il est choisi à l'exécution selon le CPU.
+inline void findClosestCentroids(const PointView& points, const PointView& centroids,
+                                 std::vector<int>& assignments, ThreadPool& pool,
+                                 AssignmentKernel& kernel) {
+    assignments.resize(points.rows());
+    kernel.setCentroids(centroids.data(), centroids.rows(), centroids.cols(), centroids.stride());
+
+    forEachChunk(pool, points.rows(), [&](size_t, size_t begin, size_t end) {
+        kernel.assign(points.data(), points.stride(), begin, end, assignments.data());
+    });
+}
+
+inline void findClosestCentroids(const PointView& points, const PointView& centroids,
+                                 std::vector<int>& assignments, ThreadPool& pool) {
+    AssignmentKernel kernel;
+    findClosestCentroids(points, centroids, assignments, pool, kernel);
+}
+
+// Même recherche par une grille de centroïdes (dimension <= 3, voir
+// CentroidGrid) : résultat identique au parcours complet en double, coût
+// sous-linéaire en K. La grille est reconstruite sur la boîte des points.
+inline void findClosestCentroids(const PointView& points, const PointView& centroids,
+                                 std::vector<int>& assignments, ThreadPool& pool,
+                                 CentroidGrid& grid) {
+    assignments.resize(points.rows());
+    if (points.empty()) return;
+    std::array<double, CentroidGrid::kMaxDims> lo, hi;
+    pointBounds(points, pool, lo.data(), hi.data());
+    grid.build(centroids.data(), centroids.rows(), centroids.cols(), centroids.stride(), lo.data(), hi.data());
+
+    forEachChunk(pool, points.rows(), [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) assignments[i] = grid.nearest(points.row(i));
+    });
+}
+
+inline std::vector<int> findClosestCentroids(const PointView& points, const PointView& centroids) {
+    ThreadPool pool(1);
+    std::vector<int> assignments;
+    findClosestCentroids(points, centroids, assignments, pool);
     return assignments;
 }
 
-// Calcule les nouveaux centroïdes basés sur les assignations
-Matrix computeCentroids(const Matrix& points, const std::vector<int>& assignments, int k) {
-    if (points.empty()) return Matrix();
-    
-    int dimensions = static_cast<int>(points[0].size());
-    Matrix centroids(k, Vector(dimensions, 0.0));
-    std::vector<int> counts(k, 0);
-    
-    // Somme des points pour chaque centroïde
-    for (size_t i = 0; i < points.size(); ++i) {
-        int cluster = assignments[i];
-        counts[cluster]++;
-        for (int d = 0; d < dimensions; ++d) {
-            centroids[cluster][d] += points[i][d];
+inline std::vector<int> findClosestCentroids(const Matrix& points, const Matrix& centroids) {
+    return findClosestCentroids(PointMatrix(points), PointMatrix(centroids));
+}
+
+// Calcule les nouveaux centroïdes basés sur les assignations.
+// Chaque bloc accumule ses propres sommes (pas d'atomiques ni de verrous),
+// puis les sommes partielles sont fusionnées dans l'ordre des blocs.
+// weights (optionnel) : poids de chaque point, ex. nombre de pixels d'une couleur.
+inline PointMatrix computeCentroids(const PointView& points, const std::vector<int>& assignments,
+                                    int k, ThreadPool& pool, const WeightView& weights = {}) {
+    if (points.empty()) return PointMatrix();
+
+    const size_t dimensions = points.cols();
+    const size_t chunks = chunkCount(points.rows());
+    std::vector<PointMatrix> partialSums(chunks, PointMatrix(k, dimensions, 0.0));
+    std::vector<std::vector<double>> partialCounts(chunks, std::vector<double>(k, 0.0));
+
+    // Somme des points pour chaque centroïde, bloc par bloc
+    forEachChunk(pool, points.rows(), [&](size_t c, size_t begin, size_t end) {
+        PointMatrix& sums = partialSums[c];
+        std::vector<double>& counts = partialCounts[c];
+        for (size_t i = begin; i < end; ++i) {
+            int cluster = assignments[i];
+            const double weight = weights.empty() ? 1.0 : weights[i];
+            counts[cluster] += weight;
+            const double* point = points.row(i);
+            double* sum = sums.row(cluster);
+            for (size_t d = 0; d < dimensions; ++d) {
+                sum[d] += weight * point[d];
+            }
+        }
+    });
+
+    // Fusion déterministe des blocs
+    PointMatrix centroids = std::move(partialSums[0]);
+    std::vector<double> counts = std::move(partialCounts[0]);
+    for (size_t c = 1; c < chunks; ++c) {
+        for (int cluster = 0; cluster < k; ++cluster) {
+            counts[cluster] += partialCounts[c][cluster];
+            const double* partial = partialSums[c].row(cluster);
+            double* sum = centroids.row(cluster);
+            for (size_t d = 0; d < dimensions; ++d) {
+                sum[d] += partial[d];
+            }
         }
     }
-    
+
     // Moyenne pour chaque centroïde
     for (int c = 0; c < k; ++c) {
         if (counts[c] > 0) {
-            for (int d = 0; d < dimensions; ++d) {
-                centroids[c][d] /= counts[c];
+            double* centroid = centroids.row(c);
+            for (size_t d = 0; d < dimensions; ++d) {
+                centroid[d] /= counts[c];
+            }
+        }
+    }
+
+    return centroids;
+}
+
+inline PointMatrix computeCentroids(const PointView& points, const std::vector<int>& assignments, int k) {
+    ThreadPool pool(1);
+    return computeCentroids(points, assignments, k, pool);
+}
+
+inline Matrix computeCentroids(const Matrix& points, const std::vector<int>& assignments, int k) {
+    return computeCentroids(PointMatrix(points), assignments, k).toRows();
+}
+
+// Somme des distances au carré de chaque point à son centroïde (inertie)
+inline double computeCost(const PointView& points, const PointView& centroids,
+                          const std::vector<int>& assignments, ThreadPool& pool,
+                          const WeightView& weights = {}) {
+    std::vector<double> partialCosts(chunkCount(points.rows()), 0.0);
+    forEachChunk(pool, points.rows(), [&](size_t c, size_t begin, size_t end) {
+        double cost = 0.0;
+        for (size_t i = begin; i < end; ++i) {
+            double d = distanceSquared(points.row(i), centroids.row(assignments[i]), points.cols());
+            cost += weights.empty() ? d : weights[i] * d;
+        }
+        partialCosts[c] = cost;
+    });
+    return std::accumulate(partialCosts.begin(), partialCosts.end(), 0.0);
+}
+
+// Tirage uniforme dans [0, 1) sans état (splitmix64) : le résultat ne dépend que
+// de (graine, indice), pas de l'ordre de parcours ni du nombre de threads
+inline double uniformAt(uint64_t seed, uint64_t index) {
+    uint64_t x = seed + (index + 1) * 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Initialise les centroïdes avec k points distincts tirés uniformément.
+// Algorithme de Floyd : O(k) mémoire, pas de permutation de taille N.
+// Avec des poids, tirage sans remise proportionnel aux poids (Efraimidis-Spirakis :
+// les k plus grandes clés log(u) / w, un tas de taille k).
+template <typename T>
+PointMatrix initializeCentroids(const BasicPointView<T>& points, int k, uint64_t seed = 0,
+                                const WeightView& weights = {}) {
+    if (seed == 0) {
+        seed = std::random_device{}();
+    }
+
+    const size_t n = points.rows();
+    const size_t count = std::min<size_t>(std::max(k, 0), n);
+    std::mt19937_64 rng(seed);
+    std::vector<size_t> chosen;
+    chosen.reserve(count);
+    if (weights.empty()) {
+        std::unordered_set<size_t> used;
+        used.reserve(count);
+        for (size_t j = n - count; j < n; ++j) {
+            size_t t = std::uniform_int_distribution<size_t>(0, j)(rng);
+            if (!used.insert(t).second) {
+                used.insert(j);
+                t = j;
+            }
+            chosen.push_back(t);
+        }
+    } else {
+        using Key = std::pair<double, size_t>;
+        std::priority_queue<Key, std::vector<Key>, std::greater<Key>> best;
+        const uint64_t keySeed = rng();
+        for (size_t i = 0; i < n; ++i) {
+            if (weights[i] <= 0.0) continue;
+            Key key(std::log(1.0 - uniformAt(keySeed, i)) / weights[i], i);
+            if (best.size() < count) {
+                best.push(key);
+            } else if (best.top() < key) {
+                best.pop();
+                best.push(key);
             }
         }
+        for (; !best.empty(); best.pop()) chosen.push_back(best.top().second);
+    }
+    std::shuffle(chosen.begin(), chosen.end(), rng);
+
+    PointMatrix centroids(k, points.cols());
+    for (size_t i = 0; i < chosen.size(); ++i) {
+        const T* point = points.row(chosen[i]);
+        std::copy(point, point + points.cols(), centroids.row(i));
     }
-    
+
     return centroids;
 }
 
-// Initialise les centroïdes aléatoirement
-Matrix initializeCentroids(const Matrix& points, int k, uint64_t seed = 0) {
+inline PointMatrix initializeCentroids(const PointView& points, int k, uint64_t seed = 0) {
+    return initializeCentroids<double>(points, k, seed);
+}
+
+inline Matrix initializeCentroids(const Matrix& points, int k, uint64_t seed = 0) {
+    return initializeCentroids(PointMatrix(points), k, seed).toRows();
+}
+
+// Stratégie de choix des centroïdes initiaux
+enum class SeedingMethod {
+    Random,          // k points tirés uniformément
+    KMeansPlusPlus,  // k-means++ : tirage D², k passes sur les données
+    KMeansParallel   // k-means|| : suréchantillonnage D² en quelques passes parallèles
+};
+
+// Tire un indice avec une probabilité proportionnelle à weight(i), à partir des
+// sommes par bloc (même découpage que forEachChunk) : seul un bloc est parcouru.
+template <typename WeightFn>
+size_t sampleWeighted(size_t n, const std::vector<double>& chunkSums, double u, WeightFn weight) {
+    const size_t chunkSize = (n + chunkSums.size() - 1) / chunkSums.size();
+    double target = u * std::accumulate(chunkSums.begin(), chunkSums.end(), 0.0);
+
+    size_t chunk = 0;
+    while (chunk + 1 < chunkSums.size() && target >= chunkSums[chunk]) {
+        target -= chunkSums[chunk++];
+    }
+    size_t begin = std::min(n, chunk * chunkSize);
+    size_t end = std::min(n, begin + chunkSize);
+    size_t last = begin;
+    for (size_t i = begin; i < end; ++i) {
+        const double w = weight(i);
+        if (w <= 0.0) continue;
+        last = i;
+        target -= w;
+        if (target < 0.0) return i;
+    }
+    return last;  // arrondis flottants : dernier point de poids non nul
+}
+
+// Premier centroïde des tirages D² : uniforme, ou proportionnel aux poids
+inline size_t pickFirstCentroid(size_t n, const WeightView& weights, std::mt19937_64& rng) {
+    if (weights.empty()) {
+        return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+    }
+    std::vector<double> total(1, std::accumulate(weights.begin(), weights.end(), 0.0));
+    if (total[0] <= 0.0) {
+        return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+    }
+    return sampleWeighted(n, total, std::uniform_real_distribution<double>(0.0, 1.0)(rng),
+                          [&](size_t i) { return weights[i]; });
+}
+
+// k-means++ (Arthur & Vassilvitskii, 2007) : chaque nouveau centroïde est tiré avec
+// une probabilité proportionnelle au carré de la distance au centroïde le plus proche.
+// Chaque étape fait une passe parallèle qui met à jour les distances minimales.
+// Avec des poids, la probabilité devient poids x D².
+template <int Dim = Dynamic, typename T>
+PointMatrix initializeCentroidsPlusPlus(const BasicPointView<T>& points, int k, uint64_t seed,
+                                        ThreadPool& pool, const WeightView& weights = {}) {
     if (seed == 0) {
         seed = std::random_device{}();
     }
-    
-    std::vector<int> indices(points.size());
-    std::iota(indices.begin(), indices.end(), 0);
-    
+
+    const size_t n = points.rows();
+    const size_t dims = points.cols();
+    PointMatrix centroids(k, dims);
+    if (n == 0 || k <= 0) return centroids;
+
     std::mt19937_64 rng(seed);
-    std::shuffle(indices.begin(), indices.end(), rng);
-    
-    Matrix centroids(k);
-    for (int i = 0; i < k && i < static_cast<int>(points.size()); ++i) {
-        centroids[i] = points[indices[i]];
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<double> minDistances(n, std::numeric_limits<double>::infinity());
+    std::vector<double> chunkSums(chunkCount(n), 0.0);
+
+    auto score = [&](size_t i) {
+        return weights.empty() ? minDistances[i] : weights[i] * minDistances[i];
+    };
+    size_t pick = pickFirstCentroid(n, weights, rng);
+    for (int c = 0; c < k; ++c) {
+        if (c > 0) {
+            bool degenerate = std::accumulate(chunkSums.begin(), chunkSums.end(), 0.0) <= 0.0;
+            pick = degenerate ? pickFirstCentroid(n, weights, rng)
+                              : sampleWeighted(n, chunkSums, uniform(rng), score);
+        }
+        const T* point = points.row(pick);
+        std::copy(point, point + dims, centroids.row(c));
+        if (c + 1 == k) break;
+
+        const double* center = centroids.row(c);
+        forEachChunk(pool, n, [&](size_t chunk, size_t begin, size_t end) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; ++i) {
+                double d = distanceSquaredFixed<Dim>(points.row(i), center, dims);
+                if (d < minDistances[i]) minDistances[i] = d;
+                sum += score(i);
+            }
+            chunkSums[chunk] = sum;
+        });
+    }
+    return centroids;
+}
+
+// k-means++ pondéré, séquentiel, puis quelques itérations de Lloyd pondérées :
+// réduit les candidats de k-means|| à k centroïdes.
+inline PointMatrix reduceCandidates(const PointMatrix& candidates, const WeightView& weights,
+                                    int k, std::mt19937_64& rng) {
+    const size_t m = candidates.rows();
+    const size_t dims = candidates.cols();
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    PointMatrix centroids(k, dims);
+
+    std::vector<double> minDistances(m, std::numeric_limits<double>::infinity());
+    std::vector<double> total(1, 0.0);
+    auto score = [&](size_t i) { return weights[i] * minDistances[i]; };
+    for (int c = 0; c < k; ++c) {
+        size_t pick = total[0] > 0.0 ? sampleWeighted(m, total, uniform(rng), score)
+                                     : pickFirstCentroid(m, weights, rng);
+        std::copy(candidates.row(pick), candidates.row(pick) + dims, centroids.row(c));
+        total[0] = 0.0;
+        for (size_t i = 0; i < m; ++i) {
+            minDistances[i] = std::min(minDistances[i],
+                                       distanceSquared(candidates.row(i), centroids.row(c), dims));
+            total[0] += score(i);
+        }
+    }
+
+    std::vector<int> labels(m, -1);
+    PointMatrix sums(k, dims);
+    std::vector<double> mass(k);
+    for (int iteration = 0; iteration < 30; ++iteration) {
+        bool changed = false;
+        for (size_t i = 0; i < m; ++i) {
+            int best = 0;
+            double bestDistance = std::numeric_limits<double>::infinity();
+            for (int c = 0; c < k; ++c) {
+                double d = distanceSquared(candidates.row(i), centroids.row(c), dims);
+                if (d < bestDistance) {
+                    bestDistance = d;
+                    best = c;
+                }
+            }
+            changed |= labels[i] != best;
+            labels[i] = best;
+        }
+        if (!changed) break;
+
+        std::fill(sums.data(), sums.data() + k * dims, 0.0);
+        std::fill(mass.begin(), mass.end(), 0.0);
+        for (size_t i = 0; i < m; ++i) {
+            mass[labels[i]] += weights[i];
+            for (size_t d = 0; d < dims; ++d) sums.row(labels[i])[d] += weights[i] * candidates.row(i)[d];
+        }
+        for (int c = 0; c < k; ++c) {
+            if (mass[c] <= 0.0) continue;
+            for (size_t d = 0; d < dims; ++d) centroids.row(c)[d] = sums.row(c)[d] / mass[c];
+        }
     }
-    
     return centroids;
 }
 
+// k-means|| (Bahmani et al., 2012) : à chaque tour, chaque point est retenu
+// indépendamment avec une probabilité oversampling * k * D²(x) / somme(D²), en une
+// passe parallèle sur les distances minimales. Les distances aux candidats ajoutés
+// sont mises à jour par le noyau d'assignation (SIMD), puis les candidats, pondérés
+// par le nombre de points qu'ils représentent, sont réduits à k centroïdes.
+template <int Dim = Dynamic, typename T>
+PointMatrix initializeCentroidsParallel(const BasicPointView<T>& points, int k, uint64_t seed,
+                                        ThreadPool& pool, AssignmentKernel& kernel,
+                                        int rounds = 5, double oversampling = 2.0,
+                                        const WeightView& weights = {}) {
+    if (seed == 0) {
+        seed = std::random_device{}();
+    }
+
+    const size_t n = points.rows();
+    const size_t dims = points.cols();
+    if (n == 0 || k <= 0) return PointMatrix(std::max(k, 0), dims);
+
+    std::mt19937_64 rng(seed);
+    const size_t chunks = chunkCount(n);
+    std::vector<double> minDistances(n, std::numeric_limits<double>::infinity());
+    std::vector<int> nearest(n, 0);
+    std::vector<double> chunkSums(chunks, 0.0);
+
+    auto weightAt = [&](size_t i) { return weights.empty() ? 1.0 : weights[i]; };
+
+    std::vector<double> candidates;
+    size_t first = pickFirstCentroid(n, weights, rng);
+    candidates.assign(points.row(first), points.row(first) + dims);
+
+    // Distances minimales aux candidats [from, to), et somme par bloc
+    auto updateDistances = [&](size_t from, size_t to) {
+        kernel.setCentroids(&candidates[from * dims], to - from, dims, dims);
+        forEachChunk(pool, n, [&](size_t chunk, size_t begin, size_t end) {
+            std::vector<int> labels(end - begin);
+            kernel.template assign<Dim>(points.row(begin), points.stride(), 0, end - begin,
+                                        labels.data());
+            double sum = 0.0;
+            for (size_t i = begin; i < end; ++i) {
+                const size_t c = from + labels[i - begin];
+                double d = distanceSquaredFixed<Dim>(points.row(i), &candidates[c * dims], dims);
+                if (d < minDistances[i]) {
+                    minDistances[i] = d;
+                    nearest[i] = static_cast<int>(c);
+                }
+                sum += weightAt(i) * minDistances[i];
+            }
+            chunkSums[chunk] = sum;
+        });
+    };
+    updateDistances(0, 1);
+
+    const double expected = oversampling * k;
+    std::vector<std::vector<size_t>> selected(chunks);
+    for (int round = 0; round < rounds; ++round) {
+        const double psi = std::accumulate(chunkSums.begin(), chunkSums.end(), 0.0);
+        if (psi <= 0.0) break;
+
+        const uint64_t roundSeed = seed ^ (0xD1B54A32D192ED03ULL * (round + 1));
+        forEachChunk(pool, n, [&](size_t chunk, size_t begin, size_t end) {
+            selected[chunk].clear();
+            for (size_t i = begin; i < end; ++i) {
+                if (uniformAt(roundSeed, i) * psi < expected * weightAt(i) * minDistances[i]) {
+                    selected[chunk].push_back(i);
+                }
+            }
+        });
+
+        const size_t from = candidates.size() / dims;
+        for (const auto& chunkSelection : selected) {
+            for (size_t i : chunkSelection) {
+                candidates.insert(candidates.end(), points.row(i), points.row(i) + dims);
+            }
+        }
+        const size_t to = candidates.size() / dims;
+        if (to == from) break;
+        updateDistances(from, to);
+    }
+
+    // Poids d'un candidat = nombre (ou poids total) des points dont il est le plus proche
+    const size_t m = candidates.size() / dims;
+    std::vector<std::vector<double>> partialWeights(chunks);
+    forEachChunk(pool, n, [&](size_t chunk, size_t begin, size_t end) {
+        partialWeights[chunk].assign(m, 0.0);
+        for (size_t i = begin; i < end; ++i) partialWeights[chunk][nearest[i]] += weightAt(i);
+    });
+    std::vector<double> candidateWeights(m, 0.0);
+    for (const auto& partial : partialWeights) {
+        for (size_t c = 0; c < m; ++c) candidateWeights[c] += partial[c];
+    }
+
+    // Un candidat sans poids est le doublon d'un candidat précédent (points
+    // identiques retenus au même tour) : seuls les candidats distincts restent
+    size_t distinct = 0;
+    for (size_t c = 0; c < m; ++c) {
+        if (candidateWeights[c] <= 0.0) continue;
+        std::copy(&candidates[c * dims], &candidates[c * dims] + dims, &candidates[distinct * dims]);
+        candidateWeights[distinct++] = candidateWeights[c];
+    }
+    candidates.resize(distinct * dims);
+    candidateWeights.resize(distinct);
+
+    if (distinct <= static_cast<size_t>(k)) {
+        // Trop peu de candidats (points très redondants) : ils sont gardés et
+        // complétés par tirage D² contre les centroïdes déjà choisis, sans
+        // reprendre un point confondu avec l'un d'eux (sauf s'il y a moins de k
+        // points distincts)
+        PointMatrix centroids(k, dims);
+        std::copy(candidates.begin(), candidates.end(), centroids.data());
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        auto score = [&](size_t i) { return weightAt(i) * minDistances[i]; };
+        for (size_t c = distinct; c < static_cast<size_t>(k); ++c) {
+            const bool degenerate = std::accumulate(chunkSums.begin(), chunkSums.end(), 0.0) <= 0.0;
+            const size_t pick = degenerate ? pickFirstCentroid(n, weights, rng)
+                                           : sampleWeighted(n, chunkSums, uniform(rng), score);
+            std::copy(points.row(pick), points.row(pick) + dims, centroids.row(c));
+            const double* center = centroids.row(c);
+            forEachChunk(pool, n, [&](size_t chunk, size_t begin, size_t end) {
+                double sum = 0.0;
+                for (size_t i = begin; i < end; ++i) {
+                    const double d = distanceSquaredFixed<Dim>(points.row(i), center, dims);
+                    if (d < minDistances[i]) minDistances[i] = d;
+                    sum += score(i);
+                }
+                chunkSums[chunk] = sum;
+            });
+        }
+        return centroids;
+    }
+    PointMatrix candidateMatrix(distinct, dims);
+    std::copy(candidates.begin(), candidates.end(), candidateMatrix.data());
+    return reduceCandidates(candidateMatrix, candidateWeights, k, rng);
+}
+
+// Variante des itérations de Lloyd.
+// Hamerly et Elkan gardent des bornes sur la distance de chaque point à son
+// centroïde (borne haute) et aux autres (borne(s) basse(s)), corrigées par le
+// déplacement des centroïdes ; les distances qui ne peuvent pas changer
+// l'assignation ne sont pas calculées. Même résultat que Lloyd.
+enum class KMeansAlgorithm {
+    Lloyd,    // toutes les distances N x K à chaque itération
+    Hamerly,  // 1 borne basse par point : mémoire O(N), idéal pour K petit
+    Elkan,    // K bornes basses par point : mémoire O(N x K), idéal pour K grand
+    Auto,     // Elkan si K > 64 en dimension >= 32 (et bornes < 512 Mo), sinon Hamerly
+    MiniBatch // mise à jour sur des échantillons aléatoires (approché, pour très grands N)
+};
+
+// Index des centroïdes pour la recherche du plus proche (assignation de Lloyd
+// et KMeans::assign). La grille (CentroidGrid) ne s'applique qu'en dimension
+// <= 3 ; elle donne les mêmes labels que le parcours complet en double.
+enum class CentroidIndex {
+    None,  // parcours des K centroïdes (noyau SIMD)
+    Grid,  // grille de cases avec listes de candidats
+    Auto   // grille si K >= 128 en dimension <= 3
+};
+
+// Paramètres de l'algorithme K-means
+struct KMeansOptions {
+    int maxIterations = 100;
+    uint64_t seed = 0;     // 0 = graine aléatoire
+    int numThreads = 1;    // 0 = tous les coeurs disponibles
+    SimdLevel simd = SimdLevel::Auto;  // noyau d'assignation (Auto = détection CPU)
+    bool useFloat32 = false;           // distances d'assignation en float32
+    CentroidIndex centroidIndex = CentroidIndex::None;
+    KMeansAlgorithm algorithm = KMeansAlgorithm::Lloyd;
+
+    SeedingMethod seeding = SeedingMethod::Random;
+    int seedingRounds = 5;          // k-means|| : nombre de tours de suréchantillonnage
+    double oversampling = 2.0;      // k-means|| : candidats attendus par tour = oversampling * k
+
+    // Mini-batch : maxIterations compte alors les passes équivalentes sur les données
+    size_t batchSize = 1024;        // points tirés par mini-batch
+    int miniBatchPatience = 20;     // mini-batchs sans amélioration de l'inertie lissée avant arrêt
+
+    bool collectStats = false;      // mesures par itération dans KMeansResult::stats
+
+    // n_init : numInit K-means indépendants (graines différentes, exécutés en
+    // parallèle sur les mêmes points), le résultat de plus faible inertie est
+    // gardé. restartCutoff (0 = désactivé) : une relance Lloyd/Hamerly/Elkan est
+    // abandonnée dès que son inertie dépasse de plus de cette fraction la
+    // meilleure inertie finale déjà obtenue (le choix dépend alors de l'ordre
+    // d'exécution des relances).
+    int numInit = 1;
+    double restartCutoff = 0.0;
+
+    // Arrêt anticipé (0 = désactivé ; sinon arrêt dès qu'un critère est atteint).
+    // Sans tolérance, l'arrêt se fait quand plus aucun label ne change. Les
+    // critères sont vérifiés en O(K) par itération (mini-batch : voir miniBatchPatience).
+    double shiftTolerance = 0.0;    // plus grand déplacement d'un centroïde (distance)
+    double inertiaTolerance = 0.0;  // baisse relative de l'inertie d'une itération à l'autre
+    double changedTolerance = 0.0;  // fraction des points qui changent de cluster
+};
+
 // Algorithme K-means complet
 struct KMeansResult {
-    Matrix centroids;
+    PointMatrix centroids;
     std::vector<int> assignments;
-    int iterations;
+    int iterations;                      // itérations effectuées (mini-batch : nombre de mini-batchs)
     double finalCost;
+    std::vector<IterationStats> stats;   // une entrée par itération si options.collectStats
+    int restartsAbandoned = 0;           // n_init : relances arrêtées par restartCutoff
 };
 
-KMeansResult kmeans(const Matrix& points, int k, int maxIterations = 100, uint64_t seed = 0) {
-    if (points.empty() || k <= 0) {
-        return {Matrix(), std::vector<int>(), 0, 0.0};
+// Moteur K-means spécialisé à la compilation sur la dimension des points.
+// Avec Dim = 2, 3 ou 4 les boucles sur les coordonnées (distance, accumulation)
+// sont entièrement déroulées ; Dim = Dynamic lit la dimension à l'exécution.
+// T est le type scalaire des points, les centroïdes restent en double.
+// Le pool de threads et les buffers de réduction sont conservés d'un appel à
+// l'autre, ce qui permet aussi de piloter l'algorithme étape par étape.
+template <typename T, int Dim = Dynamic>
+class KMeans {
+public:
+    static_assert(Dim >= 0, "Dim doit être positif (ou Dynamic)");
+
+    using Point = std::conditional_t<Dim == Dynamic, std::vector<T>, std::array<T, Dim>>;
+    using View = BasicPointView<T>;
+
+    explicit KMeans(const KMeansOptions& options = KMeansOptions())
+        : options_(options), pool_(options.numThreads), kernel_(options.simd, options.useFloat32) {}
+
+    const KMeansOptions& options() const { return options_; }
+
+    // Vue sans copie sur des points std::array (contigus en mémoire)
+    static View view(const std::vector<Point>& points) {
+        static_assert(Dim != Dynamic, "view() nécessite une dimension fixe");
+        static_assert(sizeof(Point) == Dim * sizeof(T), "std::array ne doit pas avoir de padding");
+        return View(points.empty() ? nullptr : points.front().data(), points.size(), Dim);
     }
-    
-    Matrix centroids = initializeCentroids(points, k, seed);
-    std::vector<int> assignments;
-    
-    for (int iter = 0; iter < maxIterations; ++iter) {
-        // Assignation des points aux centroïdes
-        std::vector<int> newAssignments = findClosestCentroids(points, centroids);
-        
-        // Vérifier la convergence
-        if (iter > 0 && newAssignments == assignments) {
-            assignments = newAssignments;
-            break;
-        }
-        
-        assignments = newAssignments;
-        
-        // Recalculer les centroïdes
-        Matrix newCentroids = computeCentroids(points, assignments, k);
-        centroids = newCentroids;
-    }
-    
-    // Calculer le coût final
-    double cost = 0.0;
-    for (size_t i = 0; i < points.size(); ++i) {
-        cost += distanceSquared(points[i], centroids[assignments[i]]);
-    }
-    
-    return {centroids, assignments, maxIterations, cost};
-}
-
-} // namespace KMeansLib
\ No newline at end of file
+
+    // weights (optionnel) : poids de chaque point, ex. nombre de pixels d'une couleur
+    // unique ; le résultat est celui des points répétés autant de fois.
+    KMeansResult fit(const std::vector<Point>& points, int k, const WeightView& weights = {}) {
+        return fit(view(points), k, weights);
+    }
+
+    KMeansResult fit(const View& points, int k, const WeightView& weights = {}) {
+        checkDimensions(points);
+        checkWeights(points, weights);
+        if (points.empty() || k <= 0) {
+            return {PointMatrix(), std::vector<int>(), 0, 0.0, {}};
+        }
+        if (options_.numInit > 1) return fitRestarts(points, k, weights);
+
+        switch (resolveAlgorithm(points, k)) {
+            case KMeansAlgorithm::Hamerly: return fitBounded(points, k, false, weights);
+            case KMeansAlgorithm::Elkan: return fitBounded(points, k, true, weights);
+            case KMeansAlgorithm::MiniBatch: return fitMiniBatch(points, k, weights);
+            default: return fitLloyd(points, k, weights);
+        }
+    }
+
+    // Centroïdes initiaux tirés parmi les points (selon options().seeding)
+    PointMatrix initialize(const View& points, int k, const WeightView& weights = {}) {
+        checkDimensions(points);
+        checkWeights(points, weights);
+        previousInertia_ = std::numeric_limits<double>::infinity();
+        switch (options_.seeding) {
+            case SeedingMethod::KMeansPlusPlus:
+                return initializeCentroidsPlusPlus<Dim>(points, k, options_.seed, pool_, weights);
+            case SeedingMethod::KMeansParallel:
+                return initializeCentroidsParallel<Dim>(points, k, options_.seed, pool_, kernel_,
+                                                        options_.seedingRounds, options_.oversampling,
+                                                        weights);
+            default:
+                return initializeCentroids(points, k, options_.seed, weights);
+        }
+    }
+
+    // Étape 1 : assignation de chaque point au centroïde le plus proche
+    void assign(const View& points, const PointMatrix& centroids, std::vector<int>& assignments) {
+        checkDimensions(points);
+        assignments.resize(points.rows());
+        if (prepareGrid(points, centroids)) {
+            std::vector<uint64_t> partialDistances(chunkCount(points.rows()), 0);
+            forEachChunk(pool_, points.rows(), [&](size_t c, size_t begin, size_t end) {
+                uint64_t distances = 0;
+                for (size_t i = begin; i < end; ++i) {
+                    assignments[i] = grid_.template nearest<Dim>(points.row(i), &distances);
+                }
+                partialDistances[c] = distances;
+            });
+            assignDistances_ = std::accumulate(partialDistances.begin(), partialDistances.end(), uint64_t(0));
+            return;
+        }
+        assignDistances_ = static_cast<uint64_t>(points.rows()) * centroids.rows();
+        kernel_.setCentroids(centroids.data(), centroids.rows(), centroids.cols(), centroids.cols());
+        forEachChunk(pool_, points.rows(), [&](size_t, size_t begin, size_t end) {
+            kernel_.template assign<Dim>(points.data(), points.stride(), begin, end,
+                                         assignments.data());
+        });
+    }
+
+    // Étape 2 : chaque centroïde devient la moyenne (pondérée) de ses points. Un
+    // centroïde sans aucun point garde sa position précédente.
+    void update(const View& points, const std::vector<int>& assignments, PointMatrix& centroids,
+                const WeightView& weights = {}) {
+        checkDimensions(points);
+        checkWeights(points, weights);
+        const size_t dims = dimensions(points);
+        const size_t k = centroids.rows();
+        const size_t chunks = chunkCount(points.rows());
+        resetPartials(chunks, k, dims, weights);
+
+        // Sommes partielles par bloc (pas d'atomiques ni de verrous)
+        forEachChunk(pool_, points.rows(), [&](size_t c, size_t begin, size_t end) {
+            PartialSums partial = partials(c, k, dims);
+            for (size_t i = begin; i < end; ++i) {
+                accumulate(points, weights, i, assignments[i], partial, dims);
+            }
+        });
+
+        reduceCentroids(chunks, centroids);
+    }
+
+    // Itération de Lloyd fusionnée : assignation, comptage des labels changés et
+    // sommes par cluster en une seule lecture des points (par sous-blocs qui restent
+    // en cache), puis mise à jour des centroïdes. Les buffers sont réutilisés d'une
+    // itération à l'autre. Renvoie le nombre de labels changés ; à 0, les centroïdes
+    // ne bougent pas (ils sont déjà la moyenne de leurs points).
+    size_t iterate(const View& points, PointMatrix& centroids, std::vector<int>& assignments,
+                   const WeightView& weights = {}) {
+        checkDimensions(points);
+        checkWeights(points, weights);
+        const size_t changed = assignAndAccumulate(points, centroids, assignments, weights);
+        if (changed > 0) reduceCentroids(chunkCount(points.rows()), centroids);
+        converged_ = withinTolerance(changed, points.rows());
+        return changed;
+    }
+
+    // Vrai si la dernière itération (iterate) remplit un critère d'arrêt : aucun
+    // label changé, ou l'une des tolérances de KMeansOptions atteinte
+    bool converged() const { return converged_; }
+
+    // Inertie : somme (pondérée) des distances au carré de chaque point à son centroïde
+    double cost(const View& points, const PointMatrix& centroids, const std::vector<int>& assignments,
+                const WeightView& weights = {}) {
+        checkDimensions(points);
+        checkWeights(points, weights);
+        const size_t dims = dimensions(points);
+        std::vector<double> partialCosts(chunkCount(points.rows()), 0.0);
+        forEachChunk(pool_, points.rows(), [&](size_t c, size_t begin, size_t end) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; ++i) {
+                double d = distanceSquaredFixed<Dim>(points.row(i), centroids.row(assignments[i]), dims);
+                sum += weights.empty() ? d : weights[i] * d;
+            }
+            partialCosts[c] = sum;
+        });
+        return std::accumulate(partialCosts.begin(), partialCosts.end(), 0.0);
+    }
+
+private:
+    using StatsClock = std::chrono::steady_clock;
+
+    static double secondsSince(StatsClock::time_point start) {
+        return std::chrono::duration<double>(StatsClock::now() - start).count();
+    }
+
+    // Partie « lecture des points » de iterate() : assignation, labels changés et
+    // sommes partielles par bloc (fusionnées ensuite par reduceCentroids)
+    size_t assignAndAccumulate(const View& points, const PointMatrix& centroids,
+                               std::vector<int>& assignments, const WeightView& weights) {
+        const size_t dims = dimensions(points);
+        const size_t k = centroids.rows();
+        const size_t chunks = chunkCount(points.rows());
+        assignments.resize(points.rows(), -1);
+        resetPartials(chunks, k, dims, weights);
+        partialChanged_.assign(chunks, 0);
+
+        const bool useGrid = prepareGrid(points, centroids);
+        if (!useGrid) kernel_.setCentroids(centroids.data(), centroids.rows(), centroids.cols(), centroids.cols());
+        std::vector<uint64_t> partialDistances(chunks, 0);
+        forEachChunk(pool_, points.rows(), [&](size_t c, size_t begin, size_t end) {
+            PartialSums partial = partials(c, k, dims);
+            std::array<int, kFusedBlock> labels;
+            size_t changed = 0;
+            uint64_t distances = 0;
+            for (size_t block = begin; block < end; block += kFusedBlock) {
+                const size_t count = std::min(kFusedBlock, end - block);
+                if (useGrid) {
+                    for (size_t b = 0; b < count; ++b) {
+                        labels[b] = grid_.template nearest<Dim>(points.row(block + b), &distances);
+                    }
+                } else {
+                    kernel_.template assign<Dim>(points.row(block), points.stride(), 0, count, labels.data());
+                }
+                for (size_t b = 0; b < count; ++b) {
+                    const size_t i = block + b;
+                    changed += labels[b] != assignments[i];
+                    assignments[i] = labels[b];
+                    accumulate(points, weights, i, labels[b], partial, dims);
+                }
+            }
+            partialChanged_[c] = changed;
+            partialDistances[c] = useGrid ? distances : static_cast<uint64_t>(end - begin) * k;
+        });
+
+        assignDistances_ = std::accumulate(partialDistances.begin(), partialDistances.end(), uint64_t(0));
+        return std::accumulate(partialChanged_.begin(), partialChanged_.end(), size_t(0));
+    }
+
+    // Elkan ne devient rentable que si K est grand et si une distance coûte
+    // nettement plus cher que la mise à jour de ses K bornes (dimension élevée) :
+    // en couleur (3D), Hamerly reste plus rapide même pour K = 256.
+    static constexpr int kHamerlyMaxK = 64;
+    // Points assignés puis accumulés d'un coup par l'itération fusionnée
+    static constexpr size_t kFusedBlock = 256;
+    static constexpr size_t kElkanMinDims = 32;
+    // Nombre maximal de bornes basses d'Elkan (N x K doubles, 512 Mo)
+    static constexpr size_t kElkanMaxBounds = size_t(1) << 26;
+
+    // À partir de ce K, CentroidIndex::Auto passe par la grille
+    static constexpr size_t kGridMinK = 128;
+
+    // Reconstruit la grille de centroïdes si options().centroidIndex la demande
+    // pour ces points ; faux s'il faut garder le parcours complet. Les pixels
+    // entiers ont des bornes connues, sinon la boîte des points est recalculée.
+    bool prepareGrid(const View& points, const PointMatrix& centroids) {
+        const size_t dims = dimensions(points);
+        const bool wanted = options_.centroidIndex == CentroidIndex::Grid ||
+                            (options_.centroidIndex == CentroidIndex::Auto && centroids.rows() >= kGridMinK);
+        if (!wanted || dims > CentroidGrid::kMaxDims || points.empty() || centroids.empty()) return false;
+
+        std::array<double, CentroidGrid::kMaxDims> lo, hi;
+        if (std::is_integral<T>::value) {
+            lo.fill(static_cast<double>(std::numeric_limits<T>::lowest()));
+            hi.fill(static_cast<double>(std::numeric_limits<T>::max()));
+        } else {
+            pointBounds(points, pool_, lo.data(), hi.data());
+        }
+        grid_.build(centroids.data(), centroids.rows(), dims, centroids.cols(), lo.data(), hi.data());
+        return true;
+    }
+
+    KMeansAlgorithm resolveAlgorithm(const View& points, int k) const {
+        if (options_.algorithm != KMeansAlgorithm::Auto) return options_.algorithm;
+        if (k <= kHamerlyMaxK || dimensions(points) < kElkanMinDims ||
+            points.rows() * static_cast<size_t>(k) > kElkanMaxBounds) {
+            return KMeansAlgorithm::Hamerly;
+        }
+        return KMeansAlgorithm::Elkan;
+    }
+
+    // n_init : les relances se partagent les threads du pool (une relance par
+    // thread, ou plusieurs threads par relance s'il y a moins de relances) et
+    // lisent les mêmes points. La relance r utilise la graine options().seed + r
+    // (dispersée) : sans restartCutoff, le résultat ne dépend pas du nombre de
+    // threads. À inertie égale, la relance de plus petit indice gagne.
+    KMeansResult fitRestarts(const View& points, int k, const WeightView& weights) {
+        const int runs = options_.numInit;
+        KMeansOptions runOptions = options_;
+        runOptions.numInit = 1;
+        runOptions.numThreads = std::max(1, pool_.size() / std::min(runs, pool_.size()));
+        const uint64_t base = options_.seed != 0 ? options_.seed
+                                                 : static_cast<uint64_t>(std::random_device{}());
+
+        std::atomic<double> best{std::numeric_limits<double>::infinity()};
+        std::vector<KMeansResult> results(runs);
+        std::vector<char> abandoned(runs, 0);
+        pool_.parallelFor(runs, [&](size_t r) {
+            KMeansOptions options = runOptions;
+            options.seed = base + r * 0x9E3779B97F4A7C15ull;
+            if (options.seed == 0) options.seed = 1;
+            KMeans engine(options);
+            if (options_.restartCutoff > 0.0) engine.bestInertia_ = &best;
+            results[r] = engine.fit(points, k, weights);
+            abandoned[r] = engine.abandoned_;
+            if (abandoned[r]) return;
+            double current = best.load();
+            while (results[r].finalCost < current && !best.compare_exchange_weak(current, results[r].finalCost)) {}
+        });
+
+        int chosen = -1;
+        for (int r = 0; r < runs; ++r) {
+            if (abandoned[r]) continue;
+            if (chosen < 0 || results[r].finalCost < results[chosen].finalCost) chosen = r;
+        }
+        KMeansResult result = std::move(results[chosen]);
+        result.restartsAbandoned = static_cast<int>(std::count(abandoned.begin(), abandoned.end(), 1));
+        return result;
+    }
+
+    KMeansResult fitLloyd(const View& points, int k, const WeightView& weights) {
+        PointMatrix centroids = initialize(points, k, weights);
+        std::vector<int> assignments;
+        std::vector<IterationStats> stats;
+        int iterations = 0;
+        size_t changed = 0;   // labels changés à la dernière itération (centroïdes déplacés si > 0)
+
+        while (iterations < options_.maxIterations) {
+            ++iterations;
+            if (!options_.collectStats) {
+                // Assignation et nouveaux centroïdes en une passe ; arrêt si aucun label
+                // ne change ou si une tolérance est atteinte
+                changed = iterate(points, centroids, assignments, weights);
+                if (converged_ || losing(iterations)) break;
+                continue;
+            }
+
+            // Même itération, phases chronométrées séparément. L'inertie coûte une
+            // passe de plus, faite avant que les centroïdes ne bougent.
+            IterationStats s;
+            s.iteration = iterations;
+            auto start = StatsClock::now();
+            s.labelsChanged = changed = assignAndAccumulate(points, centroids, assignments, weights);
+            s.assignSeconds = secondsSince(start);
+            s.inertia = cost(points, centroids, assignments, weights);
+            start = StatsClock::now();
+            if (s.labelsChanged > 0) reduceCentroids(chunkCount(points.rows()), centroids);
+            s.updateSeconds = secondsSince(start);
+            // La grille ne calcule que les distances à ses candidats
+            s.distances = assignDistances_;
+            s.distancesSkipped = static_cast<uint64_t>(points.rows()) * k - assignDistances_;
+            s.emptyClusters = countEmptyClusters(assignments, k, weights);
+            s.bytesTouched = points.rows() * (dimensions(points) * sizeof(T) + sizeof(int) +
+                                              (weights.empty() ? 0 : sizeof(double)));
+            stats.push_back(s);
+            if (withinTolerance(s.labelsChanged, points.rows()) || losing(iterations)) break;
+        }
+
+        // Les labels précèdent le dernier déplacement des centroïdes (arrêt sur une
+        // tolérance ou sur maxIterations) : une passe d'assignation les remet à jour
+        if (assignments.empty() || changed > 0) assign(points, centroids, assignments);
+
+        // Calculer le coût final
+        double finalCost = cost(points, centroids, assignments, weights);
+
+        return {centroids, assignments, iterations, finalCost, std::move(stats)};
+    }
+
+    // Itérations de Lloyd accélérées par l'inégalité triangulaire (Hamerly ou Elkan)
+    KMeansResult fitBounded(const View& points, int k, bool elkan, const WeightView& weights) {
+        PointMatrix centroids = initialize(points, k, weights);
+        PointMatrix previous;
+        std::vector<int> assignments(points.rows(), 0);
+        drift_.assign(k, 0.0);
+        totalDrift_.assign(k, 0.0);
+        elkanIteration_ = 0;
+        std::vector<IterationStats> stats;
+        int iterations = 0;
+        const size_t n = points.rows();
+        const size_t pointBytes = dimensions(points) * sizeof(T);
+        bool moved = false;   // centroïdes mis à jour depuis la dernière assignation
+
+        for (int iter = 0; iter < options_.maxIterations; ++iter) {
+            ++iterations;
+            moved = false;
+            // Assignation : passe complète au départ, puis seulement les points
+            // dont les bornes ne garantissent plus l'assignation
+            auto start = options_.collectStats ? StatsClock::now() : StatsClock::time_point();
+            size_t changed = iter == 0 ? initializeBounds(points, centroids, assignments, elkan)
+                                       : assignBounded(points, centroids, assignments, elkan);
+
+            if (options_.collectStats) {
+                IterationStats s;
+                s.iteration = iterations;
+                s.assignSeconds = secondsSince(start);
+                s.labelsChanged = changed;
+                s.distances = boundedDistances_;
+                s.distancesSkipped = static_cast<uint64_t>(n) * k - boundedDistances_;
+                s.inertia = cost(points, centroids, assignments, weights);
+                s.emptyClusters = countEmptyClusters(assignments, k, weights);
+                // Bornes et label de chaque point, plus les points (et bornes basses
+                // d'Elkan) de ceux que les bornes n'ont pas suffi à écarter
+                const size_t boundBytes = sizeof(int) + sizeof(double) * (elkan ? 1 : 2) +
+                                          (elkan ? sizeof(size_t) : 0);
+                s.bytesTouched = n * boundBytes +
+                                 boundedVisited_ * (pointBytes + (elkan ? k * sizeof(double) : 0));
+                stats.push_back(s);
+            }
+
+            // Vérifier la convergence
+            if (iter > 0 && changed == 0) {
+                break;
+            }
+
+            // Recalculer les centroïdes et mesurer leur déplacement
+            if (options_.collectStats) start = StatsClock::now();
+            previous = centroids;
+            update(points, assignments, centroids, weights);
+            for (int j = 0; j < k; ++j) {
+                drift_[j] = std::sqrt(distanceSquared(previous.row(j), centroids.row(j), centroids.cols()));
+            }
+            if (elkan) {
+                // Déplacement cumulé de chaque centroïde depuis le début
+                for (int j = 0; j < k; ++j) totalDrift_.push_back(totalDrift_[totalDrift_.size() - k] + drift_[j]);
+                ++elkanIteration_;
+            }
+            computeSeparation(centroids, elkan);
+            block_.assign(centroids.data(), centroids.rows(), centroids.cols(), centroids.cols());
+            moved = true;
+            if (options_.collectStats) {
+                stats.back().updateSeconds = secondsSince(start);
+                stats.back().bytesTouched += n * (pointBytes + sizeof(int) +
+                                                  (weights.empty() ? 0 : sizeof(double)));
+            }
+            if (withinTolerance(changed, n) || losing(iterations)) break;
+        }
+
+        // Arrêt après une mise à jour : labels recalculés pour les centroïdes rendus
+        if (moved) assign(points, centroids, assignments);
+        double finalCost = cost(points, centroids, assignments, weights);
+
+        return {centroids, assignments, iterations, finalCost, std::move(stats)};
+    }
+
+    // K-means mini-batch (Sculley, 2010) : chaque pas tire batchSize points au hasard
+    // (avec remise, sans permutation de taille N), les assigne puis déplace chaque
+    // centroïde vers la moyenne de ses points avec un taux d'apprentissage propre
+    // 1 / (nombre de points déjà vus par ce centroïde). On s'arrête quand l'inertie
+    // lissée (moyenne mobile exponentielle) ne s'améliore plus, puis une passe
+    // d'assignation complète produit les labels et le coût final. Avec des poids, chaque
+    // point tiré compte pour son poids (tirage uniforme, estimation sans biais).
+    KMeansResult fitMiniBatch(const View& points, int k, const WeightView& weights) {
+        const size_t n = points.rows();
+        const size_t dims = dimensions(points);
+        const size_t batchSize = std::max<size_t>(1, std::min(options_.batchSize, n));
+        const size_t batchesPerPass = std::max<size_t>(1, n / batchSize);
+        const size_t maxBatches = static_cast<size_t>(std::max(1, options_.maxIterations)) * batchesPerPass;
+        // Poids de la moyenne mobile : un mini-batch compte pour sa part des données
+        const double alpha = std::min(1.0, 2.0 * batchSize / (n + 1.0));
+
+        PointMatrix centroids = initialize(points, k, weights);
+        std::vector<double> seen(k, 0.0);
+        std::vector<T> batch(batchSize * dims);
+        std::vector<double> batchWeights(weights.empty() ? 0 : batchSize);
+        std::vector<int> labels(batchSize);
+        std::vector<double> sums(k * dims);
+        std::vector<double> counts(k);
+        std::mt19937_64 rng(options_.seed ? options_.seed ^ 0x9E3779B97F4A7C15ULL
+                                          : static_cast<uint64_t>(std::random_device{}()));
+        std::uniform_int_distribution<size_t> pick(0, n - 1);
+
+        double smoothed = -1.0;
+        double bestSmoothed = std::numeric_limits<double>::infinity();
+        int withoutImprovement = 0;
+        size_t step = 0;
+
+        // Mesures cumulées par passe équivalente (batchesPerPass mini-batchs)
+        std::vector<IterationStats> stats;
+        IterationStats pass;
+        double passInertia = 0.0;
+        size_t passBatches = 0;
+        auto flushPass = [&] {
+            pass.iteration = static_cast<int>(stats.size()) + 1;
+            // Estimation : inertie moyenne des points tirés, extrapolée aux N points
+            pass.inertia = passInertia * n / (passBatches * batchSize);
+            pass.emptyClusters = static_cast<size_t>(std::count(seen.begin(), seen.end(), 0.0));
+            stats.push_back(pass);
+            pass = IterationStats();
+            passInertia = 0.0;
+            passBatches = 0;
+        };
+
+        for (; step < maxBatches; ++step) {
+            auto start = options_.collectStats ? StatsClock::now() : StatsClock::time_point();
+            // Tirage et copie contiguë du mini-batch
+            for (size_t b = 0; b < batchSize; ++b) {
+                const size_t index = pick(rng);
+                const T* point = points.row(index);
+                std::copy(point, point + dims, &batch[b * dims]);
+                if (!weights.empty()) batchWeights[b] = weights[index];
+            }
+            View batchView(batch.data(), batchSize, dims);
+            assign(batchView, centroids, labels);
+            if (options_.collectStats) {
+                pass.assignSeconds += secondsSince(start);
+                start = StatsClock::now();
+            }
+
+            // Inertie du mini-batch (avant déplacement) et sommes par centroïde
+            double inertia = 0.0;
+            std::fill(sums.begin(), sums.end(), 0.0);
+            std::fill(counts.begin(), counts.end(), 0.0);
+            for (size_t b = 0; b < batchSize; ++b) {
+                const T* point = batchView.row(b);
+                const int j = labels[b];
+                const double weight = weights.empty() ? 1.0 : batchWeights[b];
+                inertia += weight * distanceSquaredFixed<Dim>(point, centroids.row(j), dims);
+                counts[j] += weight;
+                for (size_t d = 0; d < dims; ++d) sums[j * dims + d] += weight * point[d];
+            }
+
+            // c_j <- c_j + (somme - n_j c_j) / vus_j : moyenne de tous les points vus
+            for (int j = 0; j < k; ++j) {
+                if (counts[j] <= 0.0) continue;
+                seen[j] += counts[j];
+                const double rate = 1.0 / seen[j];
+                double* centroid = centroids.row(j);
+                for (size_t d = 0; d < dims; ++d) {
+                    centroid[d] += rate * (sums[j * dims + d] - counts[j] * centroid[d]);
+                }
+            }
+
+            if (options_.collectStats) {
+                pass.updateSeconds += secondsSince(start);
+                pass.distances += assignDistances_;
+                pass.distancesSkipped += static_cast<uint64_t>(batchSize) * k - assignDistances_;
+                // Copie du mini-batch (lecture + écriture) puis deux lectures
+                pass.bytesTouched += batchSize * (3 * dims * sizeof(T) + sizeof(int));
+                passInertia += inertia;
+                if (++passBatches == batchesPerPass) flushPass();
+            }
+
+            // Arrêt anticipé sur l'inertie moyenne lissée
+            const double meanInertia = inertia / batchSize;
+            smoothed = smoothed < 0.0 ? meanInertia : (1.0 - alpha) * smoothed + alpha * meanInertia;
+            if (smoothed < bestSmoothed) {
+                bestSmoothed = smoothed;
+                withoutImprovement = 0;
+            } else if (++withoutImprovement >= options_.miniBatchPatience) {
+                ++step;
+                break;
+            }
+        }
+
+        if (passBatches > 0) flushPass();
+
+        // Passe complète finale
+        std::vector<int> assignments;
+        assign(points, centroids, assignments);
+        double finalCost = cost(points, centroids, assignments, weights);
+
+        return {centroids, assignments, static_cast<int>(step), finalCost, std::move(stats)};
+    }
+
+    // Distance euclidienne (non carrée) : les bornes en ont besoin
+    static double pointDistance(const T* point, const double* centroid, size_t dims) {
+        return std::sqrt(distanceSquaredFixed<Dim>(point, centroid, dims));
+    }
+
+    // s(j) = moitié de la distance de c_j à son plus proche voisin ; si la borne
+    // haute d'un point assigné à j est inférieure à s(j), aucun autre centroïde ne
+    // peut être plus proche. Elkan garde aussi toute la matrice K x K.
+    void computeSeparation(const PointMatrix& centroids, bool elkan) {
+        const size_t k = centroids.rows();
+        halfSeparation_.assign(k, std::numeric_limits<double>::infinity());
+        if (elkan) centroidDistances_.assign(k * k, 0.0);
+        for (size_t a = 0; a < k; ++a) {
+            for (size_t b = a + 1; b < k; ++b) {
+                double half = 0.5 * std::sqrt(distanceSquared(centroids.row(a), centroids.row(b), centroids.cols()));
+                halfSeparation_[a] = std::min(halfSeparation_[a], half);
+                halfSeparation_[b] = std::min(halfSeparation_[b], half);
+                if (elkan) {
+                    centroidDistances_[a * k + b] = half;
+                    centroidDistances_[b * k + a] = half;
+                }
+            }
+        }
+    }
+
+    // Première passe : toutes les distances, initialisation des bornes
+    size_t initializeBounds(const View& points, const PointMatrix& centroids,
+                            std::vector<int>& assignments, bool elkan) {
+        const size_t k = centroids.rows();
+        upper_.assign(points.rows(), 0.0);
+        lower_.assign(elkan ? points.rows() * k : points.rows(), 0.0);
+        if (elkan) stamp_.assign(points.rows(), 0);
+        computeSeparation(centroids, elkan);
+        block_.assign(centroids.data(), centroids.rows(), centroids.cols(), centroids.cols());
+
+        forEachChunk(pool_, points.rows(), [&](size_t, size_t begin, size_t end) {
+            std::vector<double> scratch(block_.paddedCount());
+            for (size_t i = begin; i < end; ++i) {
+                if (elkan) {
+                    double* lower = &lower_[i * k];
+                    simd::squaredDistances<Dim>(kernel_.level(), points.row(i), block_, scratch.data());
+                    int best = 0;
+                    for (size_t j = 0; j < k; ++j) {
+                        lower[j] = std::sqrt(scratch[j]);
+                        if (scratch[j] < scratch[best]) best = static_cast<int>(j);
+                    }
+                    assignments[i] = best;
+                    upper_[i] = lower[best];
+                } else {
+                    nearestTwo(points.row(i), scratch.data(), assignments[i], upper_[i], lower_[i]);
+                }
+            }
+        });
+        boundedDistances_ = static_cast<uint64_t>(points.rows()) * k;
+        boundedVisited_ = points.rows();
+        return points.rows();
+    }
+
+    // Plus proche centroïde (best, à distance bestDistance) et distance au second.
+    // Les distances à tous les centroïdes sont calculées d'un coup par le noyau SIMD.
+    void nearestTwo(const T* point, double* scratch, int& best,
+                    double& bestDistance, double& secondDistance) const {
+        simd::squaredDistances<Dim>(kernel_.level(), point, block_, scratch);
+        double best2 = std::numeric_limits<double>::infinity();
+        double second2 = std::numeric_limits<double>::infinity();
+        best = 0;
+        for (size_t j = 0; j < block_.count(); ++j) {
+            double dist = scratch[j];
+            if (dist < best2) {
+                second2 = best2;
+                best2 = dist;
+                best = static_cast<int>(j);
+            } else if (dist < second2) {
+                second2 = dist;
+            }
+        }
+        bestDistance = std::sqrt(best2);
+        secondDistance = std::sqrt(second2);
+    }
+
+    // Passe bornée : met à jour les bornes avec le déplacement des centroïdes puis
+    // ne recalcule que les distances qui peuvent encore changer l'assignation.
+    // Renvoie le nombre de points qui ont changé de cluster.
+    size_t assignBounded(const View& points, const PointMatrix& centroids,
+                         std::vector<int>& assignments, bool elkan) {
+        const size_t dims = dimensions(points);
+        const size_t k = centroids.rows();
+
+        // Plus grand et second plus grand déplacement (borne basse de Hamerly)
+        size_t maxMover = 0;
+        for (size_t j = 1; j < k; ++j) {
+            if (drift_[j] > drift_[maxMover]) maxMover = j;
+        }
+        double maxDrift = drift_[maxMover];
+        double secondDrift = 0.0;
+        for (size_t j = 0; j < k; ++j) {
+            if (j != maxMover) secondDrift = std::max(secondDrift, drift_[j]);
+        }
+
+        const double* driftNow = &totalDrift_[elkanIteration_ * k];
+
+        const size_t chunks = chunkCount(points.rows());
+        std::vector<size_t> partialChanged(chunks, 0);
+        std::vector<uint64_t> partialDistances(chunks, 0);
+        std::vector<size_t> partialVisited(chunks, 0);
+        forEachChunk(pool_, points.rows(), [&](size_t c, size_t begin, size_t end) {
+            std::vector<double> scratch(block_.paddedCount());
+            size_t changed = 0;
+            uint64_t distances = 0;   // distances calculées (pour IterationStats)
+            size_t visited = 0;       // points non écartés par le premier test
+            for (size_t i = begin; i < end; ++i) {
+                const T* point = points.row(i);
+                const int previous = assignments[i];
+                int a = previous;
+                double upper;
+
+                if (elkan) {
+                    // Les bornes d'Elkan sont mises à jour paresseusement : elles sont
+                    // relatives à l'itération stamp_[i] et corrigées par le déplacement
+                    // cumulé des centroïdes depuis. Un point écarté par le test
+                    // upper <= s(a) coûte O(1) au lieu de O(K).
+                    const double* driftThen = &totalDrift_[stamp_[i] * k];
+                    upper = upper_[i] + (driftNow[a] - driftThen[a]);
+                    if (upper <= halfSeparation_[a]) continue;
+                    ++visited;
+
+                    double* lower = &lower_[i * k];
+                    for (size_t j = 0; j < k; ++j) {
+                        lower[j] = std::max(0.0, lower[j] - (driftNow[j] - driftThen[j]));
+                    }
+                    stamp_[i] = elkanIteration_;
+                    {
+                        bool stale = true;
+                        for (size_t j = 0; j < k; ++j) {
+                            if (static_cast<int>(j) == a) continue;
+                            double bound = std::max(lower[j], centroidDistances_[a * k + j]);
+                            if (upper <= bound) continue;
+                            if (stale) {
+                                upper = pointDistance(point, centroids.row(a), dims);
+                                lower[a] = upper;
+                                stale = false;
+                                ++distances;
+                                if (upper <= bound) continue;
+                            }
+                            double dist = pointDistance(point, centroids.row(j), dims);
+                            ++distances;
+                            lower[j] = dist;
+                            if (dist < upper || (dist == upper && static_cast<int>(j) < a)) {
+                                a = static_cast<int>(j);
+                                upper = dist;
+                            }
+                        }
+                    }
+                } else {
+                    upper = upper_[i] + drift_[a];
+                    double lower = lower_[i] - (static_cast<size_t>(a) == maxMover ? secondDrift : maxDrift);
+                    double bound = std::max(halfSeparation_[a], lower);
+                    if (upper > bound) {
+                        upper = pointDistance(point, centroids.row(a), dims);
+                        ++distances;
+                        ++visited;
+                        if (upper > bound) {
+                            nearestTwo(point, scratch.data(), a, upper, lower);
+                            distances += k;
+                        }
+                    }
+                    lower_[i] = lower;
+                }
+
+                upper_[i] = upper;
+                if (a != previous) {
+                    assignments[i] = a;
+                    ++changed;
+                }
+            }
+            partialChanged[c] = changed;
+            partialDistances[c] = distances;
+            partialVisited[c] = visited;
+        });
+        boundedDistances_ = std::accumulate(partialDistances.begin(), partialDistances.end(), uint64_t(0));
+        boundedVisited_ = std::accumulate(partialVisited.begin(), partialVisited.end(), size_t(0));
+        return std::accumulate(partialChanged.begin(), partialChanged.end(), size_t(0));
+    }
+
+    // Clusters sans aucun point (ou dont tous les points ont un poids nul)
+    static size_t countEmptyClusters(const std::vector<int>& assignments, int k,
+                                     const WeightView& weights) {
+        std::vector<double> mass(k, 0.0);
+        for (size_t i = 0; i < assignments.size(); ++i) {
+            mass[assignments[i]] += weights.empty() ? 1.0 : weights[i];
+        }
+        return static_cast<size_t>(std::count_if(mass.begin(), mass.end(), [](double m) { return m <= 0.0; }));
+    }
+
+    static size_t dimensions(const View& points) {
+        return Dim != Dynamic ? static_cast<size_t>(Dim) : points.cols();
+    }
+
+    // Points entiers (pixels uint8...) sans poids : sommes par cluster exactes en
+    // entiers 64 bits, sans conversion en double de chaque coordonnée
+    static constexpr bool kIntegerSums = std::is_integral<T>::value;
+
+    // Buffers d'un bloc : exactement un des deux pointeurs de sommes est non nul ;
+    // norms (optionnel) reçoit la somme des normes au carré (inertie en O(K))
+    struct PartialSums {
+        double* sums;
+        uint64_t* integerSums;
+        double* counts;
+        double* norms;
+    };
+
+    void resetPartials(size_t chunks, size_t k, size_t dims, const WeightView& weights) {
+        integerSums_ = kIntegerSums && weights.empty();
+        partialSums_.assign(integerSums_ ? 0 : chunks * k * dims, 0.0);
+        partialIntegerSums_.assign(integerSums_ ? chunks * k * dims : 0, 0);
+        partialCounts_.assign(chunks * k, 0.0);
+        partialNorms_.assign(trackInertia() ? chunks * k : 0, 0.0);
+    }
+
+    PartialSums partials(size_t c, size_t k, size_t dims) {
+        return {integerSums_ ? nullptr : &partialSums_[c * k * dims],
+                integerSums_ ? &partialIntegerSums_[c * k * dims] : nullptr,
+                &partialCounts_[c * k],
+                partialNorms_.empty() ? nullptr : &partialNorms_[c * k]};
+    }
+
+    // Ajoute le point i (pondéré) aux sommes de son cluster
+    static void accumulate(const View& points, const WeightView& weights, size_t i,
+                           int cluster, const PartialSums& partial, size_t dims) {
+        const T* point = points.row(i);
+        const double weight = weights.empty() ? 1.0 : weights[i];
+        partial.counts[cluster] += weight;
+        if (partial.integerSums) {
+            uint64_t* sum = partial.integerSums + cluster * dims;
+            for (size_t d = 0; d < dims; ++d) {
+                sum[d] += static_cast<uint64_t>(point[d]);
+            }
+        } else if (weights.empty()) {
+            double* sum = partial.sums + cluster * dims;
+            for (size_t d = 0; d < dims; ++d) {
+                sum[d] += point[d];
+            }
+        } else {
+            double* sum = partial.sums + cluster * dims;
+            for (size_t d = 0; d < dims; ++d) {
+                sum[d] += weight * point[d];
+            }
+        }
+        if (partial.norms) {
+            double norm = 0.0;
+            for (size_t d = 0; d < dims; ++d) norm += static_cast<double>(point[d]) * point[d];
+            partial.norms[cluster] += weight * norm;
+        }
+    }
+
+    // Fusion déterministe des sommes partielles dans l'ordre des blocs, puis moyenne.
+    // Mesure au passage, en O(K), le plus grand déplacement d'un centroïde et, si les
+    // normes ont été accumulées, l'inertie de l'assignation avec les anciens centroïdes :
+    // somme sur j de (normes_j - 2 c_j . sommes_j + poids_j |c_j|²).
+    void reduceCentroids(size_t chunks, PointMatrix& centroids) {
+        const size_t k = centroids.rows();
+        const size_t dims = centroids.cols();
+        const bool norms = !partialNorms_.empty();
+        if (integerSums_) {
+            // Sommes entières exactes : l'ordre de fusion n'a pas d'importance
+            for (size_t c = 1; c < chunks; ++c) {
+                const uint64_t* sums = &partialIntegerSums_[c * k * dims];
+                for (size_t j = 0; j < k * dims; ++j) partialIntegerSums_[j] += sums[j];
+            }
+            partialSums_.assign(partialIntegerSums_.begin(), partialIntegerSums_.begin() + k * dims);
+        }
+        for (size_t c = 1; c < chunks; ++c) {
+            const double* counts = &partialCounts_[c * k];
+            if (!integerSums_) {
+                const double* sums = &partialSums_[c * k * dims];
+                for (size_t j = 0; j < k * dims; ++j) partialSums_[j] += sums[j];
+            }
+            for (size_t j = 0; j < k; ++j) partialCounts_[j] += counts[j];
+            if (norms) {
+                for (size_t j = 0; j < k; ++j) partialNorms_[j] += partialNorms_[c * k + j];
+            }
+        }
+        double maxShift2 = 0.0;
+        double inertia = 0.0;
+        for (size_t j = 0; j < k; ++j) {
+            if (partialCounts_[j] <= 0.0) continue;
+            double* centroid = centroids.row(j);
+            double shift2 = 0.0;
+            double dot = 0.0, norm2 = 0.0;
+            for (size_t d = 0; d < dims; ++d) {
+                dot += centroid[d] * partialSums_[j * dims + d];
+                norm2 += centroid[d] * centroid[d];
+                double value = partialSums_[j * dims + d] / partialCounts_[j];
+                shift2 += (value - centroid[d]) * (value - centroid[d]);
+                centroid[d] = value;
+            }
+            maxShift2 = std::max(maxShift2, shift2);
+            if (norms) inertia += partialNorms_[j] - 2.0 * dot + partialCounts_[j] * norm2;
+        }
+        lastShift_ = std::sqrt(maxShift2);
+        lastInertia_ = norms ? std::max(0.0, inertia) : 0.0;
+    }
+
+    bool trackInertia() const { return options_.inertiaTolerance > 0.0 || bestInertia_ != nullptr; }
+
+    // n_init : vrai si cette relance perd nettement. Son inertie dépasse la
+    // meilleure inertie finale des autres relances de plus de restartCutoff, et
+    // l'écart restant vaut plus de kRestartGapFactor fois la baisse de la
+    // dernière itération : avec des baisses qui décroissent au moins
+    // géométriquement (raison 0,9), la relance ne peut plus la rattraper.
+    bool losing(int iterations) {
+        if (!bestInertia_) return false;
+        const double previous = restartPrevious_;
+        restartPrevious_ = lastInertia_;
+        if (iterations < 2) return false;
+        const double best = bestInertia_->load(std::memory_order_relaxed);
+        abandoned_ = lastInertia_ > best * (1.0 + options_.restartCutoff) &&
+                     lastInertia_ - best > kRestartGapFactor * (previous - lastInertia_);
+        return abandoned_;
+    }
+
+    // Critères d'arrêt d'une itération qui a changé `changed` labels, à partir des
+    // mesures O(K) de reduceCentroids
+    bool withinTolerance(size_t changed, size_t n) {
+        if (changed == 0) return true;
+        if (options_.changedTolerance > 0.0 && changed <= options_.changedTolerance * n) return true;
+        if (options_.shiftTolerance > 0.0 && lastShift_ <= options_.shiftTolerance) return true;
+        if (options_.inertiaTolerance > 0.0) {
+            // Pas de comparaison à la première itération (inertie précédente infinie)
+            bool flat = std::isfinite(previousInertia_) &&
+                        previousInertia_ - lastInertia_ <= options_.inertiaTolerance * previousInertia_;
+            previousInertia_ = lastInertia_;
+            if (flat) return true;
+        }
+        return false;
+    }
+
+    static void checkDimensions(const View& points) {
+        if (Dim != Dynamic && points.cols() != static_cast<size_t>(Dim)) {
+            throw std::invalid_argument("KMeans: dimension des points incompatible avec Dim");
+        }
+    }
+
+    static void checkWeights(const View& points, const WeightView& weights) {
+        if (!weights.empty() && weights.size() != points.rows()) {
+            throw std::invalid_argument("KMeans: un poids par point attendu");
+        }
+    }
+
+    KMeansOptions options_;
+    ThreadPool pool_;
+    AssignmentKernel kernel_;
+    CentroidGrid grid_;
+    std::vector<double> partialSums_;
+    std::vector<uint64_t> partialIntegerSums_;  // sommes des points entiers (kIntegerSums)
+    bool integerSums_ = false;                  // dernière accumulation faite en entiers
+    std::vector<double> partialCounts_;
+    std::vector<size_t> partialChanged_;
+    std::vector<double> partialNorms_;    // sommes des normes au carré (inertiaTolerance)
+
+    // Mesures de la dernière mise à jour, pour les critères d'arrêt
+    double lastShift_ = 0.0;
+    double lastInertia_ = 0.0;
+    double previousInertia_ = std::numeric_limits<double>::infinity();
+    bool converged_ = false;
+
+    // n_init : meilleure inertie finale partagée entre les relances
+    static constexpr double kRestartGapFactor = 10.0;
+    const std::atomic<double>* bestInertia_ = nullptr;
+    double restartPrevious_ = std::numeric_limits<double>::infinity();
+    bool abandoned_ = false;
+
+    // Bornes des variantes Hamerly / Elkan
+    std::vector<double> upper_;
+    std::vector<double> lower_;
+    std::vector<double> drift_;
+    std::vector<double> halfSeparation_;
+    std::vector<double> centroidDistances_;
+    std::vector<double> totalDrift_;      // Elkan : déplacement cumulé, une ligne de K par itération
+    std::vector<size_t> stamp_;           // Elkan : itération de référence des bornes de chaque point
+    size_t elkanIteration_ = 0;
+    uint64_t assignDistances_ = 0;        // distances calculées par le dernier assign / assignAndAccumulate
+    uint64_t boundedDistances_ = 0;       // distances calculées par la dernière passe bornée
+    size_t boundedVisited_ = 0;           // points non écartés par le premier test de borne
+    CentroidBlock<double> block_;         // centroïdes transposés pour les recherches complètes
+};
+
+// Point d'entrée générique : utilise le moteur spécialisé quand la dimension
+// vaut 2, 3 ou 4 (cas des outils 2D et des images), sinon la version dynamique.
+inline KMeansResult kmeans(const PointView& points, int k, const KMeansOptions& options,
+                           const WeightView& weights = {}) {
+    switch (points.cols()) {
+        case 2: return KMeans<double, 2>(options).fit(points, k, weights);
+        case 3: return KMeans<double, 3>(options).fit(points, k, weights);
+        case 4: return KMeans<double, 4>(options).fit(points, k, weights);
+        default: return KMeans<double>(options).fit(points, k, weights);
+    }
+}
+
+// Pixels 8 bits (images BGR, BGRA, niveaux de gris) : lus tels quels, sans
+// conversion en double ; avec options.useFloat32, distances en float32.
+inline KMeansResult kmeans(const PixelView& points, int k, const KMeansOptions& options,
+                           const WeightView& weights = {}) {
+    switch (points.cols()) {
+        case 1: return KMeans<uint8_t, 1>(options).fit(points, k, weights);
+        case 3: return KMeans<uint8_t, 3>(options).fit(points, k, weights);
+        case 4: return KMeans<uint8_t, 4>(options).fit(points, k, weights);
+        default: return KMeans<uint8_t>(options).fit(points, k, weights);
+    }
+}
+
+inline KMeansResult kmeans(const PointView& points, int k, int maxIterations = 100, uint64_t seed = 0) {
+    KMeansOptions options;
+    options.maxIterations = maxIterations;
+    options.seed = seed;
+    return kmeans(points, k, options);
+}
+
+inline KMeansResult kmeans(const Matrix& points, int k, int maxIterations = 100, uint64_t seed = 0) {
+    return kmeans(PointMatrix(points), k, maxIterations, seed);
+}
+
+} // namespace KMeansLib
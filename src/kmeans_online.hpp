@@ -0,0 +1,350 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+#include "kmeans_lib.hpp"
+
+namespace KMeansLib {
+
+// Instantané d'un OnlineKMeans (snapshot / restore), little-endian :
+//
+//   octets  0-3   "KMON"
+//   octets  4-7   version (1)
+//   octets  8-11  dimension
+//   octets 12-15  K
+//   octets 16-19  clusters ouverts (<= K)
+//   octets 20-23  réservé (0)
+//   octets 24-31  points reçus
+//   octets 32-39  facteur d'oubli (double)
+//   octets 40-    par cluster ouvert : poids, sommes (dimension), sommes des carrés (dimension)
+constexpr char kOnlineMagic[4] = {'K', 'M', 'O', 'N'};
+constexpr uint32_t kOnlineVersion = 1;
+
+struct OnlineHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t dims;
+    uint32_t k;
+    uint32_t active;
+    uint32_t reserved;
+    uint64_t seen;
+    double decay;
+};
+static_assert(sizeof(OnlineHeader) == 40, "en-tête d'instantané sur 40 octets");
+
+// K-means en ligne pour des points qui arrivent en continu. Chaque cluster ne
+// garde que des sommes courantes (poids, somme et somme des carrés des points
+// par coordonnée) : un point est assigné au centroïde le plus proche puis
+// ajouté à ses sommes, en O(K x dimension), sans jamais relire l'historique.
+// Les K premiers points distincts ouvrent les K clusters (MacQueen).
+//
+// decay < 1 fait oublier le passé : à chaque point, les sommes existantes sont
+// multipliées par decay (appliqué en O(1) par un facteur d'échelle commun). Le
+// poids d'un cluster est alors la somme des decay^âge de ses points.
+//
+// consolidate() corrige périodiquement ce que l'assignation gloutonne ne
+// rattrape pas (clusters vides, deux centroïdes sur un même groupe) en
+// fusionnant et coupant des clusters, à partir des seules sommes. Un objet ne
+// doit être modifié que par un thread à la fois ; les requêtes (nearest,
+// centroids) sont const.
+template <int Dim = Dynamic>
+class OnlineKMeans {
+public:
+    OnlineKMeans(int k, size_t dims, const KMeansOptions& options = KMeansOptions(), double decay = 1.0)
+        : k_(k), dims_(dims), decay_(decay), pool_(options.numThreads),
+          kernel_(options.simd, options.useFloat32) {
+        if (k <= 0 || dims == 0 || (Dim != Dynamic && dims != static_cast<size_t>(Dim))) {
+            throw std::invalid_argument("OnlineKMeans: K > 0 et dimension compatible avec Dim attendus");
+        }
+        if (!(decay > 0.0 && decay <= 1.0)) {
+            throw std::invalid_argument("OnlineKMeans: facteur d'oubli dans ]0, 1] attendu");
+        }
+        centroids_ = PointMatrix(k, dims);
+        weights_.assign(k, 0.0);
+        sums_.assign(k * dims, 0.0);
+        squares_.assign(k * dims, 0.0);
+    }
+
+    int k() const { return k_; }
+    size_t dims() const { return dims_; }
+    size_t seen() const { return seen_; }
+    double decay() const { return decay_; }
+
+    // Clusters déjà ouverts (K dès que K points distincts ont été reçus)
+    int active() const { return active_; }
+
+    // Centroïdes courants (les active() premières lignes sont valides)
+    const PointMatrix& centroids() const { return centroids_; }
+
+    // Poids (décroissant avec decay) du cluster j
+    double weight(int j) const { return weights_[j] * scale_; }
+
+    // Inertie des points reçus par rapport aux centroïdes courants, chacun dans
+    // le cluster où il a été ajouté, calculée en O(K) à partir des sommes
+    double inertia() const {
+        double total = 0.0;
+        for (int j = 0; j < active_; ++j) {
+            if (weights_[j] <= 0.0) continue;
+            for (size_t c = 0; c < dims_; ++c) total += weights_[j] * variance(j, c);
+        }
+        return total * scale_;
+    }
+
+    // Indice du centroïde le plus proche (le plus petit en cas d'égalité), -1
+    // si aucun point n'a encore été reçu
+    int nearest(const double* point) const {
+        int best = -1;
+        double bestDistance = std::numeric_limits<double>::infinity();
+        for (int j = 0; j < active_; ++j) {
+            const double distance = distanceSquaredFixed<Dim>(point, centroids_.row(j), dims_);
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = j;
+            }
+        }
+        return best;
+    }
+
+    // Ajoute un point (de poids `weight`) et renvoie son cluster
+    int add(const double* point, double weight = 1.0) {
+        age();
+        int j = nearest(point);
+        if (active_ < k_ && (j < 0 || distanceSquaredFixed<Dim>(point, centroids_.row(j), dims_) > 0.0)) {
+            j = active_++;
+        }
+        absorb(j, point, weight);
+        return j;
+    }
+
+    // Ajoute un petit lot : tant que des clusters restent à ouvrir, point par
+    // point ; ensuite, assignation du lot en parallèle aux centroïdes d'avant
+    // le lot (comme un mini-batch), puis ajout des points dans l'ordre. Les
+    // labels sont écrits dans `labels` si non nul (un par point).
+    void add(const PointView& batch, const std::vector<double>& weights = {}, std::vector<int>* labels = nullptr) {
+        if (batch.cols() != dims_ || (!weights.empty() && weights.size() != batch.rows())) {
+            throw std::invalid_argument("OnlineKMeans: dimension ou nombre de poids incompatible");
+        }
+        if (labels) labels->resize(batch.rows());
+        size_t first = 0;
+        for (; first < batch.rows() && active_ < k_; ++first) {
+            const int j = add(batch.row(first), weights.empty() ? 1.0 : weights[first]);
+            if (labels) (*labels)[first] = j;
+        }
+        if (first == batch.rows()) return;
+
+        labels_.resize(batch.rows());
+        kernel_.setCentroids(centroids_.data(), active_, dims_, dims_);
+        forEachChunk(pool_, batch.rows() - first, [&](size_t, size_t begin, size_t end) {
+            kernel_.template assign<Dim>(batch.row(first), batch.stride(), begin, end, labels_.data() + first);
+        });
+        for (size_t i = first; i < batch.rows(); ++i) {
+            age();
+            absorb(labels_[i], batch.row(i), weights.empty() ? 1.0 : weights[i]);
+            if (labels) (*labels)[i] = labels_[i];
+        }
+    }
+
+    // Consolidation à partir des sommes seules : tant que c'est rentable, les
+    // deux clusters les plus proches au sens de Ward (hausse d'inertie de leur
+    // fusion : w1·w2/(w1+w2)·|c1 - c2|²) sont fusionnés et le cluster libéré
+    // reprend la moitié du cluster dont la coupe fait le plus baisser
+    // l'inertie. La coupe se fait le long de la coordonnée de plus grande
+    // variance, en deux moitiés de gaussienne (moyennes à ±σ·√(2/π), variance
+    // σ²·(1 - 2/π)) : la baisse estimée est w·σ²·2/π. Corrige les clusters vides
+    // ou doublés que l'assignation gloutonne ne rattrape pas. Coût O(K² x
+    // dimension) par échange ; renvoie le nombre d'échanges (au plus K et
+    // maxMoves : les baisses étant estimées, cela exclut tout cycle).
+    int consolidate(int maxMoves = std::numeric_limits<int>::max()) {
+        int moves = 0;
+        while (active_ >= 3 && moves < std::min(maxMoves, active_)) {
+            // Paire la moins coûteuse à fusionner
+            int keep = -1, freed = -1;
+            double mergeCost = std::numeric_limits<double>::infinity();
+            for (int a = 0; a < active_; ++a) {
+                for (int b = a + 1; b < active_; ++b) {
+                    const double wa = weights_[a], wb = weights_[b];
+                    const double cost = wa + wb > 0.0
+                        ? wa * wb / (wa + wb) * distanceSquared(centroids_.row(a), centroids_.row(b), dims_)
+                        : 0.0;
+                    if (cost < mergeCost) {
+                        mergeCost = cost;
+                        keep = wa >= wb ? a : b;
+                        freed = wa >= wb ? b : a;
+                    }
+                }
+            }
+            // Cluster à couper (hors de la paire fusionnée)
+            int source = -1;
+            double gain = 0.0;
+            for (int j = 0; j < active_; ++j) {
+                if (j == keep || j == freed || weights_[j] <= 0.0) continue;
+                const double g = weights_[j] * variance(j, widestAxis(j)) * 2.0 / kPi;
+                if (g > gain) {
+                    gain = g;
+                    source = j;
+                }
+            }
+            if (source < 0 || gain <= mergeCost * (1.0 + kMinRelativeGain)) break;
+
+            weights_[keep] += weights_[freed];
+            for (size_t c = 0; c < dims_; ++c) {
+                sums_[keep * dims_ + c] += sums_[freed * dims_ + c];
+                squares_[keep * dims_ + c] += squares_[freed * dims_ + c];
+            }
+            refresh(keep);
+            split(source, freed);
+            ++moves;
+        }
+        return moves;
+    }
+
+    // Écrit l'état complet (voir OnlineHeader) ; restore() le relit
+    void snapshot(std::ostream& out) const {
+        OnlineHeader header{};
+        std::memcpy(header.magic, kOnlineMagic, 4);
+        header.version = kOnlineVersion;
+        header.dims = static_cast<uint32_t>(dims_);
+        header.k = static_cast<uint32_t>(k_);
+        header.active = static_cast<uint32_t>(active_);
+        header.seen = seen_;
+        header.decay = decay_;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        std::vector<double> cluster(1 + 2 * dims_);
+        for (int j = 0; j < active_; ++j) {
+            cluster[0] = weights_[j] * scale_;
+            for (size_t c = 0; c < dims_; ++c) {
+                cluster[1 + c] = sums_[j * dims_ + c] * scale_;
+                cluster[1 + dims_ + c] = squares_[j * dims_ + c] * scale_;
+            }
+            out.write(reinterpret_cast<const char*>(cluster.data()), cluster.size() * sizeof(double));
+        }
+        if (!out) throw std::runtime_error("OnlineKMeans: erreur d'écriture de l'instantané");
+    }
+
+    // Remplace l'état par un instantané de même K et même dimension. Les sommes
+    // relues sont déjà pondérées : le facteur d'oubli du constructeur s'applique
+    // aux points suivants, celui de l'instantané n'est que vérifié.
+    void restore(std::istream& in) {
+        OnlineHeader header{};
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!in || std::memcmp(header.magic, kOnlineMagic, 4) != 0 || header.version != kOnlineVersion) {
+            throw std::runtime_error("OnlineKMeans: instantané invalide");
+        }
+        if (header.dims != dims_ || header.k != static_cast<uint32_t>(k_) || header.active > header.k) {
+            throw std::runtime_error("OnlineKMeans: instantané de K ou de dimension différents");
+        }
+        if (!(header.decay > 0.0 && header.decay <= 1.0)) {
+            throw std::runtime_error("OnlineKMeans: facteur d'oubli de l'instantané hors de ]0, 1]");
+        }
+        std::vector<double> cluster(1 + 2 * dims_);
+        // Les clusters au-delà de header.active repartent de zéro : add() les rouvre
+        std::fill(weights_.begin(), weights_.end(), 0.0);
+        std::fill(sums_.begin(), sums_.end(), 0.0);
+        std::fill(squares_.begin(), squares_.end(), 0.0);
+        for (int j = 0; j < static_cast<int>(header.active); ++j) {
+            in.read(reinterpret_cast<char*>(cluster.data()), cluster.size() * sizeof(double));
+            if (!in) throw std::runtime_error("OnlineKMeans: instantané tronqué");
+            weights_[j] = cluster[0];
+            std::copy(cluster.begin() + 1, cluster.begin() + 1 + dims_, &sums_[j * dims_]);
+            std::copy(cluster.begin() + 1 + dims_, cluster.end(), &squares_[j * dims_]);
+        }
+        active_ = static_cast<int>(header.active);
+        seen_ = header.seen;
+        scale_ = 1.0;
+        for (int j = 0; j < active_; ++j) refresh(j);
+    }
+
+private:
+    // En dessous, les sommes sont remises à l'échelle (évite le sous-dépassement)
+    static constexpr double kMinScale = 1e-200;
+    static constexpr double kPi = 3.141592653589793;
+    // consolidate() : baisse d'inertie minimale (relative) pour un échange
+    static constexpr double kMinRelativeGain = 0.05;
+
+    // Oubli : les sommes stockées valent les vraies sommes divisées par scale_
+    void age() {
+        ++seen_;
+        if (decay_ == 1.0) return;
+        scale_ *= decay_;
+        if (scale_ >= kMinScale) return;
+        for (double& w : weights_) w *= scale_;
+        for (double& s : sums_) s *= scale_;
+        for (double& s : squares_) s *= scale_;
+        scale_ = 1.0;
+    }
+
+    void absorb(int j, const double* point, double weight) {
+        const double w = weight / scale_;
+        weights_[j] += w;
+        for (size_t c = 0; c < dims_; ++c) {
+            sums_[j * dims_ + c] += w * point[c];
+            squares_[j * dims_ + c] += w * point[c] * point[c];
+        }
+        refresh(j);
+    }
+
+    // Centroïde = moyenne des sommes (inchangé pour un cluster de poids nul)
+    void refresh(int j) {
+        if (weights_[j] <= 0.0) return;
+        for (size_t c = 0; c < dims_; ++c) centroids_[j][c] = sums_[j * dims_ + c] / weights_[j];
+    }
+
+    double variance(int j, size_t c) const {
+        const double mean = sums_[j * dims_ + c] / weights_[j];
+        return std::max(0.0, squares_[j * dims_ + c] / weights_[j] - mean * mean);
+    }
+
+    size_t widestAxis(int j) const {
+        size_t axis = 0;
+        for (size_t c = 1; c < dims_; ++c) {
+            if (variance(j, c) > variance(j, axis)) axis = c;
+        }
+        return axis;
+    }
+
+    // Coupe `source` en deux moitiés, la seconde remplaçant le cluster `target`
+    void split(int source, int target) {
+        const size_t axis = widestAxis(source);
+        const double sigma = std::sqrt(variance(source, axis));
+        const double offset = sigma * std::sqrt(2.0 / kPi);
+        const double halfVariance = sigma * sigma * (1.0 - 2.0 / kPi);
+        const double half = weights_[source] / 2.0;
+        weights_[target] = half;
+        for (size_t c = 0; c < dims_; ++c) {
+            const double mean = sums_[source * dims_ + c] / weights_[source];
+            const double var = c == axis ? halfVariance : variance(source, c);
+            for (int side = 0; side < 2; ++side) {
+                const int j = side ? target : source;
+                const double m = c == axis ? mean + (side ? offset : -offset) : mean;
+                sums_[j * dims_ + c] = half * m;
+                squares_[j * dims_ + c] = half * (var + m * m);
+            }
+        }
+        weights_[source] = half;
+        refresh(source);
+        refresh(target);
+    }
+
+    int k_;
+    size_t dims_;
+    double decay_;
+    ThreadPool pool_;
+    AssignmentKernel kernel_;
+    PointMatrix centroids_;
+    int active_ = 0;
+    size_t seen_ = 0;
+    double scale_ = 1.0;
+    std::vector<double> weights_;   // sommes stockées divisées par scale_
+    std::vector<double> sums_;
+    std::vector<double> squares_;
+    std::vector<int> labels_;       // labels d'un lot (réutilisés)
+};
+
+} // namespace KMeansLib
@@ -0,0 +1,128 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "kmeans_lib.hpp"
+
+namespace KMeansLib {
+
+// Adaptateurs entre cv::Mat et le moteur K-means, sans copie des pixels.
+//
+// MatPointView voit chaque pixel comme un point dont les coordonnées sont ses
+// `dims` premiers canaux. Une image continue (cas de imread) est lue en place,
+// le pas entre deux points étant le nombre de canaux : une image BGRA peut
+// ainsi être regroupée sur ses seuls canaux BGR. Une image non continue
+// (sous-région d'une autre image) est d'abord compactée, une seule fois.
+// Les labels produits suivent l'ordre des pixels, ligne par ligne.
+template <typename T>
+class MatPointView {
+public:
+    explicit MatPointView(const cv::Mat& image, int dims = 0) {
+        if (image.depth() != cv::DataType<T>::depth) {
+            throw std::invalid_argument("MatPointView: type de pixel incompatible");
+        }
+        const int channels = image.channels();
+        if (dims <= 0) dims = channels;
+        if (dims > channels) {
+            throw std::invalid_argument("MatPointView: plus de dimensions que de canaux");
+        }
+        copied_ = !image.isContinuous();
+        image_ = copied_ ? image.clone() : image;
+        view_ = BasicPointView<T>(image_.ptr<T>(), image_.total(), dims, channels);
+    }
+
+    const BasicPointView<T>& view() const { return view_; }
+    int rows() const { return image_.rows; }
+    int cols() const { return image_.cols; }
+    bool copied() const { return copied_; }   // vrai si l'image a dû être compactée
+
+private:
+    cv::Mat image_;   // partage les pixels de l'image source (ou leur copie compacte)
+    BasicPointView<T> view_;
+    bool copied_ = false;
+};
+
+using MatPixels = MatPointView<uint8_t>;
+
+// Options d'arrêt anticipé et de relances communes aux outils d'images
+// (kmeans_image, kmeans_pipeline, kmeans_image_refactored)
+constexpr const char* kStoppingSynopsis =
+    "[--tol-shift S] [--tol-inertia R] [--tol-changed F] [--n-init R] [--restart-cutoff F]";
+
+// Lit argv[i] et sa valeur (i avancé) si c'est une option d'arrêt ou de relance
+inline bool parseStoppingOption(int argc, char** argv, int& i, KMeansOptions& options) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) return false;
+    if (arg == "--tol-shift") options.shiftTolerance = std::stod(argv[++i]);
+    else if (arg == "--tol-inertia") options.inertiaTolerance = std::stod(argv[++i]);
+    else if (arg == "--tol-changed") options.changedTolerance = std::stod(argv[++i]);
+    else if (arg == "--n-init") options.numInit = std::max(1, std::stoi(argv[++i]));
+    else if (arg == "--restart-cutoff") options.restartCutoff = std::stod(argv[++i]);
+    else return false;
+    return true;
+}
+
+inline void printStoppingUsage(std::ostream& out) {
+    out << "  --tol-shift S: stop when no centroid moves more than S (color units, 0-255)\n"
+        << "  --tol-inertia R: stop when the inertia drops by less than R (relative)\n"
+        << "  --tol-changed F: stop when less than a fraction F of the pixels change cluster (default: 0 = until no label changes)\n"
+        << "  --n-init R: run R independently seeded K-means in parallel and keep the lowest cost (default: 1)\n"
+        << "  --restart-cutoff F: with --n-init, abandon a run that stays more than F above the best cost (default: 0 = never)\n";
+}
+
+// Image 8 bits reconstruite à partir des labels : la palette (centroïdes
+// arrondis) est calculée une fois, puis chaque bande de lignes est écrite en
+// parallèle par une lecture de table par pixel.
+constexpr int kLabelBandRows = 64;
+
+inline cv::Mat labelsToImage(const std::vector<int>& labels, const PointMatrix& centroids,
+                             int rows, int cols, ThreadPool& pool) {
+    const size_t channels = centroids.cols();
+    if (channels == 0 || channels > 4 || labels.size() != static_cast<size_t>(rows) * cols) {
+        throw std::invalid_argument("labelsToImage: labels ou centroïdes incompatibles avec l'image");
+    }
+    std::vector<uint8_t> palette(centroids.rows() * channels);
+    for (size_t j = 0; j < centroids.rows(); ++j) {
+        for (size_t c = 0; c < channels; ++c) {
+            palette[j * channels + c] = cv::saturate_cast<uint8_t>(centroids[j][c]);
+        }
+    }
+
+    cv::Mat image(rows, cols, CV_MAKETYPE(CV_8U, static_cast<int>(channels)));
+    const size_t bands = (static_cast<size_t>(rows) + kLabelBandRows - 1) / kLabelBandRows;
+    pool.parallelFor(bands, [&](size_t band) {
+        const int first = static_cast<int>(band) * kLabelBandRows;
+        const int last = std::min(rows, first + kLabelBandRows);
+        for (int r = first; r < last; ++r) {
+            uint8_t* out = image.ptr<uint8_t>(r);
+            const int* label = labels.data() + static_cast<size_t>(r) * cols;
+            if (channels == 3) {
+                for (int x = 0; x < cols; ++x, out += 3) {
+                    const uint8_t* color = &palette[label[x] * 3];
+                    out[0] = color[0];
+                    out[1] = color[1];
+                    out[2] = color[2];
+                }
+            } else {
+                for (int x = 0; x < cols; ++x, out += channels) {
+                    std::copy_n(&palette[label[x] * channels], channels, out);
+                }
+            }
+        }
+    });
+    return image;
+}
+
+// numThreads : 0 = tous les coeurs
+inline cv::Mat labelsToImage(const std::vector<int>& labels, const PointMatrix& centroids,
+                             int rows, int cols, int numThreads = 0) {
+    ThreadPool pool(numThreads);
+    return labelsToImage(labels, centroids, rows, cols, pool);
+}
+
+} // namespace KMeansLib
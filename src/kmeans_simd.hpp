@@ -0,0 +1,487 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define KMEANS_HAVE_X86_SIMD 1
+#include <immintrin.h>
+// Pas de FMA dans les noyaux : les distances restent identiques au bit près à
+// celles du code scalaire (AVX-512 implique FMA, d'où fp-contract=off pour GCC)
+#define KMEANS_TARGET_AVX2 __attribute__((target("avx2")))
+#if defined(__clang__)
+#define KMEANS_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define KMEANS_TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#endif
+#else
+#define KMEANS_HAVE_X86_SIMD 0
+#endif
+
+namespace KMeansLib {
+
+// Dimension des points connue seulement à l'exécution (voir KMeans<T, Dim>)
+constexpr int Dynamic = 0;
+
+// Jeu d'instructions utilisé par le noyau d'assignation
+enum class SimdLevel {
+    Auto,    // meilleur niveau supporté par le CPU (détecté à l'exécution)
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+inline const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Auto: return "auto";
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::AVX512: return "avx512";
+    }
+    return "?";
+}
+
+// Meilleur niveau SIMD supporté par le CPU courant (détecté une seule fois)
+inline SimdLevel detectSimdLevel() {
+#if KMEANS_HAVE_X86_SIMD
+    static const SimdLevel level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+// Niveau effectivement utilisable : Auto est résolu et un niveau demandé mais
+// non supporté par le CPU est ramené au meilleur niveau disponible.
+inline SimdLevel resolveSimdLevel(SimdLevel requested) {
+    SimdLevel best = detectSimdLevel();
+    if (requested == SimdLevel::Auto) return best;
+    return static_cast<int>(requested) <= static_cast<int>(best) ? requested : best;
+}
+
+// Centroïdes transposés (une ligne par dimension) pour comparer un point à
+// plusieurs centroïdes à la fois. Le nombre de colonnes est arrondi au multiple
+// de kLanes supérieur ; les centroïdes de remplissage sont à l'infini et ne
+// sont donc jamais choisis.
+template <typename T>
+class CentroidBlock {
+public:
+    static constexpr size_t kLanes = 16;
+
+    // centroids[j * stride + d] -> data_[d * padded_ + j]
+    void assign(const double* centroids, size_t count, size_t dims, size_t stride) {
+        count_ = count;
+        dims_ = dims;
+        padded_ = (count + kLanes - 1) / kLanes * kLanes;
+        data_.assign(dims_ * padded_, std::numeric_limits<T>::infinity());
+        for (size_t j = 0; j < count_; ++j) {
+            for (size_t d = 0; d < dims_; ++d) {
+                data_[d * padded_ + j] = static_cast<T>(centroids[j * stride + d]);
+            }
+        }
+    }
+
+    const T* dim(size_t d) const { return data_.data() + d * padded_; }
+    size_t count() const { return count_; }
+    size_t paddedCount() const { return padded_; }
+    size_t dims() const { return dims_; }
+
+private:
+    std::vector<T> data_;
+    size_t count_ = 0;
+    size_t dims_ = 0;
+    size_t padded_ = 0;
+};
+
+namespace simd {
+
+// Les noyaux sont paramétrés par la dimension (Dim != Dynamic : boucle sur les
+// coordonnées déroulée à la compilation) et par le type scalaire P des points.
+
+// Version scalaire de référence (même ordre d'opérations que distanceSquared)
+template <int Dim, typename P, typename T>
+void assignRangeScalar(const P* points, size_t stride, size_t begin, size_t end,
+                       const CentroidBlock<T>& block, int* out) {
+    const size_t dims = Dim != Dynamic ? Dim : block.dims();
+    for (size_t i = begin; i < end; ++i) {
+        const P* p = points + i * stride;
+        T bestDistance = std::numeric_limits<T>::infinity();
+        int bestCentroid = 0;
+        for (size_t j = 0; j < block.count(); ++j) {
+            T sum = 0;
+            for (size_t d = 0; d < dims; ++d) {
+                T diff = static_cast<T>(p[d]) - block.dim(d)[j];
+                sum += diff * diff;
+            }
+            if (sum < bestDistance) {
+                bestDistance = sum;
+                bestCentroid = static_cast<int>(j);
+            }
+        }
+        out[i] = bestCentroid;
+    }
+}
+
+#if KMEANS_HAVE_X86_SIMD
+
+// Réduction finale des meilleurs candidats par voie, sans branchement : plus
+// petite distance, puis plus petit indice parmi les voies à égalité (même résultat
+// que le parcours scalaire). Les voies restées à l'infini portent l'indice
+// `padded`, ramené à 0 comme dans le parcours scalaire.
+KMEANS_TARGET_AVX2
+inline __m256d broadcastMinAVX2(__m256d v) {
+    v = _mm256_min_pd(v, _mm256_permute2f128_pd(v, v, 0x01));
+    return _mm256_min_pd(v, _mm256_permute_pd(v, 0x5));
+}
+
+KMEANS_TARGET_AVX2
+inline __m256 broadcastMinAVX2(__m256 v) {
+    v = _mm256_min_ps(v, _mm256_permute2f128_ps(v, v, 0x01));
+    v = _mm256_min_ps(v, _mm256_permute_ps(v, 0x4E));
+    return _mm256_min_ps(v, _mm256_permute_ps(v, 0xB1));
+}
+
+KMEANS_TARGET_AVX2
+inline int reduceLanesAVX2(__m256d best0, __m256d best1, __m256d index0, __m256d index1,
+                           size_t padded, size_t count) {
+    const __m256d none = _mm256_set1_pd(static_cast<double>(padded));
+    const __m256d best = broadcastMinAVX2(_mm256_min_pd(best0, best1));
+    index0 = _mm256_blendv_pd(none, index0, _mm256_cmp_pd(best0, best, _CMP_EQ_OQ));
+    index1 = _mm256_blendv_pd(none, index1, _mm256_cmp_pd(best1, best, _CMP_EQ_OQ));
+    int result = static_cast<int>(_mm256_cvtsd_f64(broadcastMinAVX2(_mm256_min_pd(index0, index1))));
+    return result < static_cast<int>(count) ? result : 0;
+}
+
+KMEANS_TARGET_AVX2
+inline int reduceLanesAVX2(__m256 best, __m256 index, size_t padded, size_t count) {
+    const __m256 none = _mm256_set1_ps(static_cast<float>(padded));
+    index = _mm256_blendv_ps(none, index, _mm256_cmp_ps(best, broadcastMinAVX2(best), _CMP_EQ_OQ));
+    int result = static_cast<int>(_mm256_cvtss_f32(broadcastMinAVX2(index)));
+    return result < static_cast<int>(count) ? result : 0;
+}
+
+// Minimum des voies de registres AVX-512, réduit par moitiés 256 bits comme en
+// AVX2. Les intrinsèques sans masque (_mm512_reduce_min_*, _mm512_min_pd,
+// extraction, conversion vers 256 bits) passent par _mm512_undefined_* et font
+// avertir GCC 12 sous -Wall : l'extraction masquée (toutes voies actives) donne
+// le même code.
+template <int Half>
+KMEANS_TARGET_AVX512
+inline __m256d halfAVX512(__m512d v) {
+    return _mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xF, v, Half);
+}
+
+KMEANS_TARGET_AVX512
+inline double minLaneAVX512(__m512d a, __m512d b) {
+    const __m256d low = _mm256_min_pd(halfAVX512<0>(a), halfAVX512<0>(b));
+    const __m256d high = _mm256_min_pd(halfAVX512<1>(a), halfAVX512<1>(b));
+    return _mm256_cvtsd_f64(broadcastMinAVX2(_mm256_min_pd(low, high)));
+}
+
+KMEANS_TARGET_AVX512
+inline float minLaneAVX512(__m512 v) {
+    const __m256 low = _mm256_castpd_ps(halfAVX512<0>(_mm512_castps_pd(v)));
+    const __m256 high = _mm256_castpd_ps(halfAVX512<1>(_mm512_castps_pd(v)));
+    return _mm256_cvtss_f32(broadcastMinAVX2(_mm256_min_ps(low, high)));
+}
+
+KMEANS_TARGET_AVX512
+inline int reduceLanesAVX512(__m512d best0, __m512d best1, __m512d index0, __m512d index1,
+                             size_t padded, size_t count) {
+    const __m512d none = _mm512_set1_pd(static_cast<double>(padded));
+    const __m512d best = _mm512_set1_pd(minLaneAVX512(best0, best1));
+    index0 = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(best0, best, _CMP_EQ_OQ), none, index0);
+    index1 = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(best1, best, _CMP_EQ_OQ), none, index1);
+    int result = static_cast<int>(minLaneAVX512(index0, index1));
+    return result < static_cast<int>(count) ? result : 0;
+}
+
+KMEANS_TARGET_AVX512
+inline int reduceLanesAVX512(__m512 best, __m512 index, size_t padded, size_t count) {
+    const __m512 none = _mm512_set1_ps(static_cast<float>(padded));
+    const __m512 minimum = _mm512_set1_ps(minLaneAVX512(best));
+    index = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(best, minimum, _CMP_EQ_OQ), none, index);
+    int result = static_cast<int>(minLaneAVX512(index));
+    return result < static_cast<int>(count) ? result : 0;
+}
+
+// AVX2, double : 8 centroïdes par pas (2 registres de 4)
+template <int Dim, typename P>
+KMEANS_TARGET_AVX2
+void assignRangeAVX2(const P* points, size_t stride, size_t begin, size_t end,
+                     const CentroidBlock<double>& block, int* out) {
+    const size_t dims = Dim != Dynamic ? Dim : block.dims();
+    const size_t padded = block.paddedCount();
+    const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    const __m256d step = _mm256_set1_pd(8.0);
+
+    for (size_t i = begin; i < end; ++i) {
+        const P* p = points + i * stride;
+        __m256d best0 = inf, best1 = inf;
+        __m256d bestIdx0 = _mm256_set1_pd(static_cast<double>(padded));
+        __m256d bestIdx1 = bestIdx0;
+        __m256d idx0 = _mm256_setr_pd(0, 1, 2, 3);
+        __m256d idx1 = _mm256_setr_pd(4, 5, 6, 7);
+
+        for (size_t j = 0; j < padded; j += 8) {
+            __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+            for (size_t d = 0; d < dims; ++d) {
+                const double* c = block.dim(d) + j;
+                __m256d pv = _mm256_set1_pd(static_cast<double>(p[d]));
+                __m256d diff0 = _mm256_sub_pd(pv, _mm256_loadu_pd(c));
+                __m256d diff1 = _mm256_sub_pd(pv, _mm256_loadu_pd(c + 4));
+                sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(diff0, diff0));
+                sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(diff1, diff1));
+            }
+            __m256d less0 = _mm256_cmp_pd(sum0, best0, _CMP_LT_OQ);
+            __m256d less1 = _mm256_cmp_pd(sum1, best1, _CMP_LT_OQ);
+            best0 = _mm256_blendv_pd(best0, sum0, less0);
+            best1 = _mm256_blendv_pd(best1, sum1, less1);
+            bestIdx0 = _mm256_blendv_pd(bestIdx0, idx0, less0);
+            bestIdx1 = _mm256_blendv_pd(bestIdx1, idx1, less1);
+            idx0 = _mm256_add_pd(idx0, step);
+            idx1 = _mm256_add_pd(idx1, step);
+        }
+        out[i] = reduceLanesAVX2(best0, best1, bestIdx0, bestIdx1, padded, block.count());
+    }
+}
+
+// AVX2, float : 8 centroïdes par pas
+template <int Dim, typename P>
+KMEANS_TARGET_AVX2
+void assignRangeAVX2(const P* points, size_t stride, size_t begin, size_t end,
+                     const CentroidBlock<float>& block, int* out) {
+    const size_t dims = Dim != Dynamic ? Dim : block.dims();
+    const size_t padded = block.paddedCount();
+    const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    const __m256 step = _mm256_set1_ps(8.0f);
+
+    for (size_t i = begin; i < end; ++i) {
+        const P* p = points + i * stride;
+        __m256 best = inf;
+        __m256 bestIdx = _mm256_set1_ps(static_cast<float>(padded));
+        __m256 idx = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+
+        for (size_t j = 0; j < padded; j += 8) {
+            __m256 sum = _mm256_setzero_ps();
+            for (size_t d = 0; d < dims; ++d) {
+                __m256 diff = _mm256_sub_ps(_mm256_set1_ps(static_cast<float>(p[d])),
+                                            _mm256_loadu_ps(block.dim(d) + j));
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(diff, diff));
+            }
+            __m256 less = _mm256_cmp_ps(sum, best, _CMP_LT_OQ);
+            best = _mm256_blendv_ps(best, sum, less);
+            bestIdx = _mm256_blendv_ps(bestIdx, idx, less);
+            idx = _mm256_add_ps(idx, step);
+        }
+        out[i] = reduceLanesAVX2(best, bestIdx, padded, block.count());
+    }
+}
+
+// AVX-512, double : 16 centroïdes par pas (2 registres de 8)
+template <int Dim, typename P>
+KMEANS_TARGET_AVX512
+void assignRangeAVX512(const P* points, size_t stride, size_t begin, size_t end,
+                         const CentroidBlock<double>& block, int* out) {
+    const size_t dims = Dim != Dynamic ? Dim : block.dims();
+    const size_t padded = block.paddedCount();
+    const __m512d inf = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+    const __m512d step = _mm512_set1_pd(16.0);
+
+    for (size_t i = begin; i < end; ++i) {
+        const P* p = points + i * stride;
+        __m512d best0 = inf, best1 = inf;
+        __m512d bestIdx0 = _mm512_set1_pd(static_cast<double>(padded));
+        __m512d bestIdx1 = bestIdx0;
+        __m512d idx0 = _mm512_setr_pd(0, 1, 2, 3, 4, 5, 6, 7);
+        __m512d idx1 = _mm512_setr_pd(8, 9, 10, 11, 12, 13, 14, 15);
+
+        for (size_t j = 0; j < padded; j += 16) {
+            __m512d sum0 = _mm512_setzero_pd(), sum1 = _mm512_setzero_pd();
+            for (size_t d = 0; d < dims; ++d) {
+                const double* c = block.dim(d) + j;
+                __m512d pv = _mm512_set1_pd(static_cast<double>(p[d]));
+                __m512d diff0 = _mm512_sub_pd(pv, _mm512_loadu_pd(c));
+                __m512d diff1 = _mm512_sub_pd(pv, _mm512_loadu_pd(c + 8));
+                sum0 = _mm512_add_pd(sum0, _mm512_mul_pd(diff0, diff0));
+                sum1 = _mm512_add_pd(sum1, _mm512_mul_pd(diff1, diff1));
+            }
+            __mmask8 less0 = _mm512_cmp_pd_mask(sum0, best0, _CMP_LT_OQ);
+            __mmask8 less1 = _mm512_cmp_pd_mask(sum1, best1, _CMP_LT_OQ);
+            best0 = _mm512_mask_blend_pd(less0, best0, sum0);
+            best1 = _mm512_mask_blend_pd(less1, best1, sum1);
+            bestIdx0 = _mm512_mask_blend_pd(less0, bestIdx0, idx0);
+            bestIdx1 = _mm512_mask_blend_pd(less1, bestIdx1, idx1);
+            idx0 = _mm512_add_pd(idx0, step);
+            idx1 = _mm512_add_pd(idx1, step);
+        }
+        out[i] = reduceLanesAVX512(best0, best1, bestIdx0, bestIdx1, padded, block.count());
+    }
+}
+
+// AVX-512, float : 16 centroïdes par pas
+template <int Dim, typename P>
+KMEANS_TARGET_AVX512
+void assignRangeAVX512(const P* points, size_t stride, size_t begin, size_t end,
+                         const CentroidBlock<float>& block, int* out) {
+    const size_t dims = Dim != Dynamic ? Dim : block.dims();
+    const size_t padded = block.paddedCount();
+    const __m512 inf = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+    const __m512 step = _mm512_set1_ps(16.0f);
+
+    for (size_t i = begin; i < end; ++i) {
+        const P* p = points + i * stride;
+        __m512 best = inf;
+        __m512 bestIdx = _mm512_set1_ps(static_cast<float>(padded));
+        __m512 idx = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+        for (size_t j = 0; j < padded; j += 16) {
+            __m512 sum = _mm512_setzero_ps();
+            for (size_t d = 0; d < dims; ++d) {
+                __m512 diff = _mm512_sub_ps(_mm512_set1_ps(static_cast<float>(p[d])),
+                                            _mm512_loadu_ps(block.dim(d) + j));
+                sum = _mm512_add_ps(sum, _mm512_mul_ps(diff, diff));
+            }
+            __mmask16 less = _mm512_cmp_ps_mask(sum, best, _CMP_LT_OQ);
+            best = _mm512_mask_blend_ps(less, best, sum);
+            bestIdx = _mm512_mask_blend_ps(less, bestIdx, idx);
+            idx = _mm512_add_ps(idx, step);
+        }
+        out[i] = reduceLanesAVX512(best, bestIdx, padded, block.count());
+    }
+}
+
+#endif // KMEANS_HAVE_X86_SIMD
+
+// Distances au carré d'un point à toutes les colonnes du bloc (remplissage compris,
+// à +inf), dans le même ordre d'opérations que distanceSquared.
+template <int Dim, typename P>
+void squaredDistancesScalar(const P* p, const CentroidBlock<double>& block, double* out) {
+    const size_t dims = Dim != Dynamic ? Dim : block.dims();
+    const size_t padded = block.paddedCount();
+    std::fill(out, out + padded, 0.0);
+    for (size_t d = 0; d < dims; ++d) {
+        const double* c = block.dim(d);
+        const double pd = static_cast<double>(p[d]);
+        for (size_t j = 0; j < padded; ++j) {
+            double diff = pd - c[j];
+            out[j] += diff * diff;
+        }
+    }
+}
+
+#if KMEANS_HAVE_X86_SIMD
+
+template <int Dim, typename P>
+KMEANS_TARGET_AVX2
+void squaredDistancesAVX2(const P* p, const CentroidBlock<double>& block, double* out) {
+    const size_t dims = Dim != Dynamic ? Dim : block.dims();
+    for (size_t j = 0; j < block.paddedCount(); j += 4) {
+        __m256d sum = _mm256_setzero_pd();
+        for (size_t d = 0; d < dims; ++d) {
+            __m256d diff = _mm256_sub_pd(_mm256_set1_pd(static_cast<double>(p[d])),
+                                         _mm256_loadu_pd(block.dim(d) + j));
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(diff, diff));
+        }
+        _mm256_storeu_pd(out + j, sum);
+    }
+}
+
+template <int Dim, typename P>
+KMEANS_TARGET_AVX512
+void squaredDistancesAVX512(const P* p, const CentroidBlock<double>& block, double* out) {
+    const size_t dims = Dim != Dynamic ? Dim : block.dims();
+    for (size_t j = 0; j < block.paddedCount(); j += 8) {
+        __m512d sum = _mm512_setzero_pd();
+        for (size_t d = 0; d < dims; ++d) {
+            __m512d diff = _mm512_sub_pd(_mm512_set1_pd(static_cast<double>(p[d])),
+                                         _mm512_loadu_pd(block.dim(d) + j));
+            sum = _mm512_add_pd(sum, _mm512_mul_pd(diff, diff));
+        }
+        _mm512_storeu_pd(out + j, sum);
+    }
+}
+
+#endif // KMEANS_HAVE_X86_SIMD
+
+template <int Dim, typename P>
+void squaredDistances(SimdLevel level, const P* p, const CentroidBlock<double>& block, double* out) {
+#if KMEANS_HAVE_X86_SIMD
+    if (level == SimdLevel::AVX512) return squaredDistancesAVX512<Dim>(p, block, out);
+    if (level == SimdLevel::AVX2) return squaredDistancesAVX2<Dim>(p, block, out);
+#endif
+    (void)level;
+    squaredDistancesScalar<Dim>(p, block, out);
+}
+
+} // namespace simd
+
+// Noyau d'assignation au plus proche centroïde. Le jeu d'instructions est choisi
+// une fois à la construction ; setCentroids() prépare le bloc transposé, à
+// rappeler après chaque mise à jour des centroïdes.
+// useFloat32 calcule les distances en float (2x plus de centroïdes par registre) ;
+// le résultat peut alors différer du calcul en double pour des points quasi équidistants.
+class AssignmentKernel {
+public:
+    explicit AssignmentKernel(SimdLevel level = SimdLevel::Auto, bool useFloat32 = false)
+        : level_(resolveSimdLevel(level)), useFloat32_(useFloat32) {}
+
+    void setCentroids(const double* centroids, size_t count, size_t dims, size_t stride) {
+        if (useFloat32_) {
+            blockFloat_.assign(centroids, count, dims, stride);
+        } else {
+            blockDouble_.assign(centroids, count, dims, stride);
+        }
+    }
+
+    // out[i] = indice du centroïde le plus proche du point i, pour i dans [begin, end)
+    template <int Dim = Dynamic, typename P>
+    void assign(const P* points, size_t stride, size_t begin, size_t end, int* out) const {
+        if (useFloat32_) {
+            run<Dim>(blockFloat_, points, stride, begin, end, out);
+        } else {
+            run<Dim>(blockDouble_, points, stride, begin, end, out);
+        }
+    }
+
+    SimdLevel level() const { return level_; }
+    bool usesFloat32() const { return useFloat32_; }
+
+private:
+    // En dessous, le remplissage du bloc et la réduction des voies coûtent
+    // plus cher que le parcours scalaire
+    static constexpr size_t kMinSimdCentroids = 8;
+
+    template <int Dim, typename T, typename P>
+    void run(const CentroidBlock<T>& block, const P* points, size_t stride,
+             size_t begin, size_t end, int* out) const {
+#if KMEANS_HAVE_X86_SIMD
+        if (block.count() < kMinSimdCentroids) {
+            simd::assignRangeScalar<Dim>(points, stride, begin, end, block, out);
+            return;
+        }
+        if (level_ == SimdLevel::AVX512) {
+            simd::assignRangeAVX512<Dim>(points, stride, begin, end, block, out);
+            return;
+        }
+        if (level_ == SimdLevel::AVX2) {
+            simd::assignRangeAVX2<Dim>(points, stride, begin, end, block, out);
+            return;
+        }
+#endif
+        simd::assignRangeScalar<Dim>(points, stride, begin, end, block, out);
+    }
+
+    SimdLevel level_;
+    bool useFloat32_;
+    CentroidBlock<double> blockDouble_;
+    CentroidBlock<float> blockFloat_;
+};
+
+} // namespace KMeansLib
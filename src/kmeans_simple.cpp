@@ -21,9 +21,9 @@ int main() {
     
     cout << "Centroids:\n";
     for (size_t i = 0; i < result.centroids.size(); ++i) {
-        for (size_t j = 0; j < result.centroids[i].size(); ++j) {
+        for (size_t j = 0; j < result.centroids.cols(); ++j) {
             cout << result.centroids[i][j];
-            if (j < result.centroids[i].size() - 1) cout << " ";
+            if (j < result.centroids.cols() - 1) cout << " ";
         }
         cout << "\n";
     }
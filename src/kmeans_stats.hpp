@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace KMeansLib {
+
+// Mesures d'une itération de K-means, collectées seulement si
+// KMeansOptions::collectStats est vrai. Sans cette option, aucune mesure n'est
+// prise (ni horloge, ni passe supplémentaire sur les données).
+struct IterationStats {
+    int iteration = 0;              // à partir de 1
+    double assignSeconds = 0.0;     // assignation (et sommes par cluster pour Lloyd fusionné)
+    double updateSeconds = 0.0;     // calcul des nouveaux centroïdes
+    uint64_t distances = 0;         // distances point-centroïde calculées
+    uint64_t distancesSkipped = 0;  // distances évitées par les bornes (Hamerly / Elkan) ou la grille
+    size_t labelsChanged = 0;       // points ayant changé de cluster
+    double inertia = 0.0;           // inertie de l'assignation (centroïdes avant mise à jour)
+    size_t emptyClusters = 0;       // clusters sans aucun point (ou de poids nul)
+    uint64_t bytesTouched = 0;      // octets lus ou écrits : points, labels, poids, bornes
+};
+
+inline void writeStatsCsv(std::ostream& out, const std::vector<IterationStats>& stats) {
+    out << "iteration,assign_seconds,update_seconds,distances,distances_skipped,"
+           "labels_changed,inertia,empty_clusters,bytes_touched\n";
+    for (const IterationStats& s : stats) {
+        out << s.iteration << ',' << s.assignSeconds << ',' << s.updateSeconds << ','
+            << s.distances << ',' << s.distancesSkipped << ',' << s.labelsChanged << ','
+            << s.inertia << ',' << s.emptyClusters << ',' << s.bytesTouched << '\n';
+    }
+}
+
+inline void writeStatsJson(std::ostream& out, const std::vector<IterationStats>& stats) {
+    out << "[\n";
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const IterationStats& s = stats[i];
+        out << "  {\"iteration\": " << s.iteration
+            << ", \"assign_seconds\": " << s.assignSeconds
+            << ", \"update_seconds\": " << s.updateSeconds
+            << ", \"distances\": " << s.distances
+            << ", \"distances_skipped\": " << s.distancesSkipped
+            << ", \"labels_changed\": " << s.labelsChanged
+            << ", \"inertia\": " << s.inertia
+            << ", \"empty_clusters\": " << s.emptyClusters
+            << ", \"bytes_touched\": " << s.bytesTouched << "}"
+            << (i + 1 < stats.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+// Écrit les mesures en JSON si le chemin se termine par .json, en CSV sinon
+inline void saveStats(const std::string& path, const std::vector<IterationStats>& stats) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("saveStats: impossible d'écrire " + path);
+    out.precision(10);
+    const bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (json) writeStatsJson(out, stats);
+    else writeStatsCsv(out, stats);
+}
+
+} // namespace KMeansLib
@@ -0,0 +1,276 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "kmeans_online.hpp"
+#include "kmeans_stream.hpp"
+#include "point_file.hpp"
+
+using namespace std;
+using namespace KMeansLib;
+
+void printCentroids(const PointMatrix& centroids) {
+    cout << "\nCentroïdes:\n";
+    for (size_t j = 0; j < centroids.rows(); ++j) {
+        for (size_t d = 0; d < centroids.cols(); ++d) cout << (d ? " " : "  ") << centroids[j][d];
+        cout << "\n";
+    }
+}
+
+void printMemory(size_t engineBytes) {
+    cout << "Mémoire du moteur: " << engineBytes / (1024.0 * 1024.0) << " Mo, pic du processus: "
+         << peakResidentBytes() / (1024.0 * 1024.0) << " Mo\n";
+}
+
+void writeStats(const string& statsPath, const KMeansResult& result) {
+    if (statsPath.empty()) return;
+    saveStats(statsPath, result.stats);
+    cout << "Mesures par itération: " << statsPath << "\n";
+}
+
+// K-means hors mémoire : la source est lue par blocs, la mémoire utilisée ne
+// dépend pas de la taille du fichier.
+template <int Dim>
+int runStreaming(PointSource& source, int k, const KMeansOptions& options,
+                 size_t blockRows, const string& labelsPath, const string& statsPath) {
+    StreamingKMeans<Dim> engine(options, blockRows);
+
+    auto start = chrono::steady_clock::now();
+    KMeansResult result = engine.fit(source, k);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    const StreamingStats& stats = engine.stats();
+
+    cout << "Points: " << stats.points << " (dimension " << source.dims() << ")\n";
+    cout << "K-means terminé après " << result.iterations << " passes (" << seconds << " s)\n";
+    cout << "Inertie: " << result.finalCost << "\n";
+    cout << "Lecture non recouverte: " << stats.readSeconds << " s, calcul: " << stats.computeSeconds << " s\n";
+    writeStats(statsPath, result);
+
+    if (!labelsPath.empty()) {
+        FILE* labels = fopen(labelsPath.c_str(), "wb");
+        if (!labels) {
+            cerr << "Erreur: Impossible d'écrire " << labelsPath << "\n";
+            return 1;
+        }
+        engine.assignAll(source, result.centroids, [&](size_t, const int* block, size_t count) {
+            fwrite(block, sizeof(int), count, labels);
+        });
+        fclose(labels);
+        cout << "Labels (int32) sauvegardés: " << labelsPath << "\n";
+    }
+
+    printMemory(engine.stats().bufferBytes);
+    printCentroids(result.centroids);
+    return 0;
+}
+
+// Fichier .kmp en mémoire (block_rows = 0) : K-means directement sur la projection
+// mmap du fichier, sans copie des points
+template <typename T, int Dim>
+int runMapped(const MappedPointFile& file, int k, const KMeansOptions& options,
+              const string& labelsPath, const string& statsPath) {
+    auto start = chrono::steady_clock::now();
+    KMeansResult result = KMeans<T, Dim>(options).fit(file.view<T>(), k, file.weights());
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Points: " << file.count() << " (dimension " << file.dims() << ", "
+         << pointTypeName(file.type()) << (file.hasWeights() ? ", pondérés" : "") << ", mmap)\n";
+    cout << "K-means terminé après " << result.iterations << " itérations (" << seconds << " s)\n";
+    cout << "Inertie: " << result.finalCost << "\n";
+    writeStats(statsPath, result);
+
+    if (!labelsPath.empty()) {
+        FILE* labels = fopen(labelsPath.c_str(), "wb");
+        if (!labels) {
+            cerr << "Erreur: Impossible d'écrire " << labelsPath << "\n";
+            return 1;
+        }
+        fwrite(result.assignments.data(), sizeof(int), result.assignments.size(), labels);
+        fclose(labels);
+        cout << "Labels (int32) sauvegardés: " << labelsPath << "\n";
+    }
+
+    printMemory(0);
+    printCentroids(result.centroids);
+    return 0;
+}
+
+// Réglages du mode --online
+struct OnlineSettings {
+    bool enabled = false;
+    size_t batchRows = 256;              // points lus et ajoutés ensemble
+    double decay = 1.0;                  // facteur d'oubli par point
+    size_t consolidateEvery = 100000;    // points entre deux consolidations (0 = jamais)
+    string snapshotPath, restorePath;
+};
+
+// K-means en ligne : chaque point lu est ajouté aux sommes courantes de son
+// cluster, une seule lecture de la source, état reprenable (--restore)
+template <int Dim>
+int runOnline(PointSource& source, int k, const KMeansOptions& options, const OnlineSettings& settings,
+              const string& labelsPath) {
+    OnlineKMeans<Dim> online(k, source.dims(), options, settings.decay);
+    if (!settings.restorePath.empty()) {
+        ifstream in(settings.restorePath, ios::binary);
+        if (!in) throw runtime_error("impossible d'ouvrir " + settings.restorePath);
+        online.restore(in);
+        cout << "État repris: " << online.seen() << " points déjà reçus (" << settings.restorePath << ")\n";
+    }
+    FILE* labelsFile = nullptr;
+    if (!labelsPath.empty() && !(labelsFile = fopen(labelsPath.c_str(), "wb"))) {
+        cerr << "Erreur: Impossible d'écrire " << labelsPath << "\n";
+        return 1;
+    }
+
+    const size_t batchRows = max<size_t>(1, settings.batchRows);
+    vector<double> buffer(batchRows * source.dims());
+    vector<int> labels;
+    size_t points = 0, sinceConsolidation = 0;
+    int moves = 0;
+    double consolidateSeconds = 0.0;
+    source.rewind();
+    auto start = chrono::steady_clock::now();
+    for (size_t rows; (rows = source.read(buffer.data(), batchRows)) > 0; points += rows) {
+        if (rows == 1) {
+            labels.assign(1, online.add(buffer.data()));
+        } else {
+            online.add(PointView(buffer.data(), rows, source.dims()), {}, &labels);
+        }
+        if (labelsFile) fwrite(labels.data(), sizeof(int), rows, labelsFile);
+        sinceConsolidation += rows;
+        if (settings.consolidateEvery && sinceConsolidation >= settings.consolidateEvery) {
+            auto consolidateStart = chrono::steady_clock::now();
+            moves += online.consolidate();
+            consolidateSeconds += chrono::duration<double>(chrono::steady_clock::now() - consolidateStart).count();
+            sinceConsolidation = 0;
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (labelsFile) fclose(labelsFile);
+
+    cout << "Points: " << points << " (dimension " << source.dims() << "), en ligne par lots de " << batchRows << "\n";
+    cout << "Ajout: " << seconds << " s, " << 1e6 * seconds / max<size_t>(1, points) << " µs par point"
+         << " (lecture et consolidation comprises)\n";
+    cout << "Consolidations: " << moves << " clusters déplacés (" << consolidateSeconds << " s)\n";
+    cout << "Inertie (sommes courantes): " << online.inertia() << "\n";
+    if (!labelsPath.empty()) cout << "Labels (int32, au moment de l'ajout) sauvegardés: " << labelsPath << "\n";
+    if (!settings.snapshotPath.empty()) {
+        ofstream out(settings.snapshotPath, ios::binary);
+        online.snapshot(out);
+        cout << "État sauvegardé: " << settings.snapshotPath << "\n";
+    }
+
+    // Lot lu, labels, et par cluster : centroïde, poids, sommes et sommes des carrés
+    printMemory((buffer.size() + static_cast<size_t>(k) * (3 * source.dims() + 1)) * sizeof(double) +
+                labels.capacity() * sizeof(int));
+    PointMatrix centroids = online.centroids();
+    centroids.resize(online.active());
+    printCentroids(centroids);
+    return 0;
+}
+
+template <int Dim>
+int run(PointSource& source, const MappedPointFile* mapped, int k, const KMeansOptions& options,
+        size_t blockRows, const string& labelsPath, const string& statsPath, const OnlineSettings& online) {
+    if (online.enabled) return runOnline<Dim>(source, k, options, online, labelsPath);
+    if (mapped && blockRows == 0) {
+        switch (mapped->type()) {
+            case PointType::Float64: return runMapped<double, Dim>(*mapped, k, options, labelsPath, statsPath);
+            case PointType::Float32: return runMapped<float, Dim>(*mapped, k, options, labelsPath, statsPath);
+            default: break;
+        }
+        cout << "Points " << pointTypeName(mapped->type()) << " : lecture par blocs convertis\n";
+    }
+    if (mapped && mapped->hasWeights()) {
+        cout << "Attention: les poids du fichier ne sont utilisés qu'en mémoire (block_rows = 0)\n";
+    }
+    return runStreaming<Dim>(source, k, options, blockRows ? blockRows : (size_t(1) << 20), labelsPath,
+                             statsPath);
+}
+
+int main(int argc, char** argv) {
+    // Options nommées (--stats, --tol-*, --online...) puis arguments positionnels
+    vector<string> args;
+    string statsPath;
+    OnlineSettings online;
+    KMeansOptions options;
+    options.inertiaTolerance = 1e-6;   // arrêt quand une passe ne gagne plus rien
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--stats" && i + 1 < argc) statsPath = argv[++i];
+        else if (arg == "--tol-shift" && i + 1 < argc) options.shiftTolerance = stod(argv[++i]);
+        else if (arg == "--tol-inertia" && i + 1 < argc) options.inertiaTolerance = stod(argv[++i]);
+        else if (arg == "--online") online.enabled = true;
+        else if (arg == "--online-batch" && i + 1 < argc) online.batchRows = stoul(argv[++i]);
+        else if (arg == "--decay" && i + 1 < argc) online.decay = stod(argv[++i]);
+        else if (arg == "--consolidate-every" && i + 1 < argc) online.consolidateEvery = stoul(argv[++i]);
+        else if (arg == "--snapshot" && i + 1 < argc) online.snapshotPath = argv[++i];
+        else if (arg == "--restore" && i + 1 < argc) online.restorePath = argv[++i];
+        else args.push_back(arg);
+    }
+    online.enabled |= !online.snapshotPath.empty() || !online.restorePath.empty();
+
+    if (args.size() < 3) {
+        cerr << "Usage: " << argv[0] << " [--stats FILE] [--tol-shift S] [--tol-inertia R] [--online [--snapshot FILE] [--restore FILE]] <points> <dims> <K> [max_iterations] [block_rows] [threads] [labels_out]\n";
+        cerr << "  points: .kmp point file (see kmeans_convert) or raw row-major doubles\n";
+        cerr << "  dims: values per point, 0 = read from the .kmp header\n";
+        cerr << "  max_iterations: maximum passes over the file (default: 20)\n";
+        cerr << "  block_rows: points per block in memory (default: 1048576),\n";
+        cerr << "              0 = cluster a .kmp file in place through mmap\n";
+        cerr << "  threads: worker threads, 0 = all cores (default: 0)\n";
+        cerr << "  labels_out: optional int32 label per point\n";
+        cerr << "  --stats FILE: write per-iteration timings and counters (.json, otherwise CSV)\n";
+        cerr << "  --tol-shift S: stop when no centroid moves more than S (default: 0 = until no centroid moves)\n";
+        cerr << "  --tol-inertia R: stop when a pass lowers the inertia by less than R (relative, default: 1e-6, 0 = off)\n";
+        cerr << "  --online: single pass, each point added to running sums (max_iterations and block_rows ignored)\n";
+        cerr << "  --online-batch N: with --online, points read and added together (default: 256, 1 = one by one)\n";
+        cerr << "  --decay F: with --online, forgetting factor applied per point (default: 1 = no forgetting)\n";
+        cerr << "  --consolidate-every N: with --online, merge/split clusters every N points (default: 100000, 0 = never)\n";
+        cerr << "  --snapshot FILE: with --online, save the clustering state at the end\n";
+        cerr << "  --restore FILE: with --online, resume from a saved state (--decay still applies to new points)\n";
+        return 1;
+    }
+
+    string inputPath = args[0];
+    size_t dims = stoul(args[1]);
+    int k = stoi(args[2]);
+    options.maxIterations = (args.size() >= 4) ? stoi(args[3]) : 20;
+    size_t blockRows = (args.size() >= 5) ? stoul(args[4]) : (size_t(1) << 20);
+    options.numThreads = (args.size() >= 6) ? stoi(args[5]) : 0;
+    string labelsPath = (args.size() >= 7) ? args[6] : "";
+    options.collectStats = !statsPath.empty();
+
+    try {
+        unique_ptr<PointSource> source;
+        const MappedPointFile* mapped = nullptr;
+        if (isPointFile(inputPath)) {
+            auto file = make_unique<MappedPointFile>(inputPath);
+            if (dims != 0 && dims != file->dims()) {
+                cerr << "Erreur: " << inputPath << " contient des points de dimension " << file->dims() << "\n";
+                return 1;
+            }
+            dims = file->dims();
+            mapped = file.get();
+            source = move(file);
+        } else {
+            if (dims == 0) {
+                cerr << "Erreur: dimension requise pour un fichier brut\n";
+                return 1;
+            }
+            source = make_unique<RawPointFile>(inputPath, dims);
+        }
+
+        switch (dims) {
+            case 2: return run<2>(*source, mapped, k, options, blockRows, labelsPath, statsPath, online);
+            case 3: return run<3>(*source, mapped, k, options, blockRows, labelsPath, statsPath, online);
+            case 4: return run<4>(*source, mapped, k, options, blockRows, labelsPath, statsPath, online);
+            default: return run<Dynamic>(*source, mapped, k, options, blockRows, labelsPath, statsPath, online);
+        }
+    } catch (const exception& e) {
+        cerr << "Erreur: " << e.what() << "\n";
+        return 1;
+    }
+}
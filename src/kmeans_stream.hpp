@@ -0,0 +1,361 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "kmeans_lib.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace KMeansLib {
+
+// Source de points lue bloc par bloc, pour des données plus grandes que la mémoire.
+// Chaque itération de K-means relit la source depuis le début.
+class PointSource {
+public:
+    virtual ~PointSource() = default;
+
+    virtual size_t dims() const = 0;
+
+    // Revient au premier point
+    virtual void rewind() = 0;
+
+    // Copie au plus maxRows points (ligne par ligne) dans buffer, qui contient
+    // maxRows * dims() doubles. Renvoie le nombre de points lus, 0 en fin de source.
+    virtual size_t read(double* buffer, size_t maxRows) = 0;
+};
+
+// Fichier brut de doubles ligne par ligne, sans en-tête
+class RawPointFile : public PointSource {
+public:
+    RawPointFile(const std::string& path, size_t dims)
+        : file_(std::fopen(path.c_str(), "rb")), dims_(dims) {
+        if (!file_) {
+            throw std::runtime_error("RawPointFile: impossible d'ouvrir " + path);
+        }
+    }
+
+    ~RawPointFile() override { std::fclose(file_); }
+
+    RawPointFile(const RawPointFile&) = delete;
+    RawPointFile& operator=(const RawPointFile&) = delete;
+
+    size_t dims() const override { return dims_; }
+    void rewind() override { std::rewind(file_); }
+
+    size_t read(double* buffer, size_t maxRows) override {
+        return std::fread(buffer, sizeof(double) * dims_, maxRows, file_);
+    }
+
+private:
+    std::FILE* file_;
+    size_t dims_;
+};
+
+// Source sur des points déjà en mémoire (tests, petites données)
+class PointViewSource : public PointSource {
+public:
+    explicit PointViewSource(const PointView& points) : points_(points) {}
+
+    size_t dims() const override { return points_.cols(); }
+    void rewind() override { next_ = 0; }
+
+    size_t read(double* buffer, size_t maxRows) override {
+        const size_t rows = std::min(maxRows, points_.rows() - next_);
+        for (size_t i = 0; i < rows; ++i, ++next_) {
+            std::copy(points_.row(next_), points_.row(next_) + points_.cols(), buffer + i * points_.cols());
+        }
+        return rows;
+    }
+
+private:
+    PointView points_;
+    size_t next_ = 0;
+};
+
+// Pic de mémoire résidente du processus en octets (0 si indisponible)
+inline size_t peakResidentBytes() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+        return static_cast<size_t>(usage.ru_maxrss);          // octets
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;   // kilo-octets
+#endif
+    }
+#endif
+    return 0;
+}
+
+// Mesures d'une exécution de StreamingKMeans
+struct StreamingStats {
+    size_t passes = 0;             // passes complètes sur la source (échantillonnage compris)
+    size_t points = 0;             // nombre de points de la source
+    size_t bufferBytes = 0;        // mémoire du moteur : 2 blocs, échantillon, sommes
+    size_t peakResidentBytes = 0;  // pic de mémoire résidente du processus
+    double readSeconds = 0.0;      // attente des lectures non recouvertes par le calcul
+    double computeSeconds = 0.0;   // assignation et accumulation
+};
+
+// K-means hors mémoire : la source est lue par blocs de blockRows points et chaque
+// itération de Lloyd est une passe sur les blocs. Pendant le traitement d'un bloc,
+// le suivant est lu en parallèle (double tampon). La mémoire ne dépend que de
+// blockRows, K et la dimension, jamais du nombre de points.
+//
+// Les centroïdes initiaux viennent d'un échantillon uniforme de la source
+// (réservoir, une passe) sur lequel options.seeding est appliqué. L'arrêt se fait
+// quand plus aucun centroïde ne bouge, après options.maxIterations passes, ou sur
+// les tolérances options.shiftTolerance et options.inertiaTolerance (calculées en
+// O(K) à partir des sommes de la passe). changedTolerance est ignorée : les
+// labels ne sont pas conservés d'une passe à l'autre.
+template <int Dim = Dynamic>
+class StreamingKMeans {
+public:
+    explicit StreamingKMeans(const KMeansOptions& options = KMeansOptions(),
+                             size_t blockRows = size_t(1) << 20)
+        : options_(options), blockRows_(std::max<size_t>(1, blockRows)),
+          pool_(options.numThreads), kernel_(options.simd, options.useFloat32) {}
+
+    const StreamingStats& stats() const { return stats_; }
+
+    // Résultat sans assignations (une par point serait hors mémoire) : voir assignAll().
+    // finalCost est l'inertie de la dernière passe.
+    KMeansResult fit(PointSource& source, int k) {
+        dims_ = Dim != Dynamic ? Dim : source.dims();
+        if (source.dims() != dims_) {
+            throw std::invalid_argument("StreamingKMeans: dimension de la source incompatible avec Dim");
+        }
+        stats_ = StreamingStats();
+        allocateBlocks();
+        if (k <= 0) return {PointMatrix(), std::vector<int>(), 0, 0.0, {}};
+
+        PointMatrix centroids = seed(source, k);
+        double previousInertia = std::numeric_limits<double>::infinity();
+        double inertia = 0.0;
+        int iterations = 0;
+        std::vector<IterationStats> passStats;
+
+        while (iterations < options_.maxIterations) {
+            auto start = std::chrono::steady_clock::now();
+            inertia = accumulatePass(source, centroids);
+            ++iterations;
+            auto assigned = std::chrono::steady_clock::now();
+
+            const double shift = updateCentroids(centroids);
+            if (options_.collectStats) {
+                // Les labels ne sont pas conservés d'une passe à l'autre : labelsChanged reste à 0
+                IterationStats s;
+                s.iteration = iterations;
+                s.assignSeconds = std::chrono::duration<double>(assigned - start).count();
+                s.updateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - assigned).count();
+                s.distances = static_cast<uint64_t>(stats_.points) * k;
+                s.inertia = inertia;
+                s.emptyClusters = static_cast<size_t>(std::count(counts_.begin(), counts_.end(), 0.0));
+                s.bytesTouched = stats_.points * dims_ * sizeof(double);
+                passStats.push_back(s);
+            }
+            if (shift == 0.0) break;
+            if (options_.shiftTolerance > 0.0 && shift <= options_.shiftTolerance) break;
+            // Pas de comparaison à la première passe (inertie précédente infinie)
+            if (options_.inertiaTolerance > 0.0 && std::isfinite(previousInertia) &&
+                previousInertia - inertia <= options_.inertiaTolerance * previousInertia) break;
+            previousInertia = inertia;
+        }
+
+        finishStats(k);
+        return {centroids, std::vector<int>(), iterations, inertia, std::move(passStats)};
+    }
+
+    // Passe d'assignation finale : onBlock(premierIndice, labels, nombre) pour chaque
+    // bloc, dans l'ordre de la source. Renvoie l'inertie.
+    template <typename Fn>
+    double assignAll(PointSource& source, const PointMatrix& centroids, Fn&& onBlock) {
+        dims_ = Dim != Dynamic ? Dim : source.dims();
+        allocateBlocks();
+        labels_.resize(blockRows_);
+        kernel_.setCentroids(centroids.data(), centroids.rows(), centroids.cols(), centroids.cols());
+
+        double inertia = 0.0;
+        forEachBlock(source, [&](const PointView& block, size_t first) {
+            std::vector<double> partialCosts(chunkCount(block.rows()), 0.0);
+            forEachChunk(pool_, block.rows(), [&](size_t c, size_t begin, size_t end) {
+                kernel_.template assign<Dim>(block.data(), block.stride(), begin, end, labels_.data());
+                double cost = 0.0;
+                for (size_t i = begin; i < end; ++i) {
+                    cost += distanceSquaredFixed<Dim>(block.row(i), centroids.row(labels_[i]), dims_);
+                }
+                partialCosts[c] = cost;
+            });
+            inertia += std::accumulate(partialCosts.begin(), partialCosts.end(), 0.0);
+            onBlock(first, static_cast<const int*>(labels_.data()), block.rows());
+        });
+        stats_.peakResidentBytes = peakResidentBytes();
+        return inertia;
+    }
+
+private:
+    // Points assignés puis accumulés d'un coup (comme KMeans::iterate)
+    static constexpr size_t kFusedBlock = 256;
+    // Taille minimale de l'échantillon servant à l'initialisation (au moins 64 points par centroïde)
+    static constexpr size_t kMinSampleRows = size_t(1) << 16;
+
+    void allocateBlocks() {
+        front_.resize(blockRows_ * dims_);
+        back_.resize(blockRows_ * dims_);
+    }
+
+    // Lit la source bloc par bloc : fn(bloc, indice du premier point) pendant que le
+    // bloc suivant est lu par un autre thread
+    template <typename Fn>
+    void forEachBlock(PointSource& source, Fn&& fn) {
+        using Clock = std::chrono::steady_clock;
+        source.rewind();
+
+        auto start = Clock::now();
+        size_t rows = source.read(front_.data(), blockRows_);
+        stats_.readSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+        size_t first = 0;
+        while (rows > 0) {
+            auto pending = std::async(std::launch::async, [&] {
+                return source.read(back_.data(), blockRows_);
+            });
+
+            start = Clock::now();
+            fn(PointView(front_.data(), rows, dims_), first);
+            auto computed = Clock::now();
+            size_t next = pending.get();
+            stats_.computeSeconds += std::chrono::duration<double>(computed - start).count();
+            stats_.readSeconds += std::chrono::duration<double>(Clock::now() - computed).count();
+
+            first += rows;
+            rows = next;
+            front_.swap(back_);
+        }
+        stats_.points = first;
+        stats_.passes++;
+    }
+
+    // Échantillon uniforme par réservoir, puis initialisation en mémoire
+    PointMatrix seed(PointSource& source, int k) {
+        const size_t capacity = std::max<size_t>(kMinSampleRows, static_cast<size_t>(k) * 64);
+        std::vector<double> sample;
+        std::mt19937_64 rng(options_.seed ? options_.seed : std::random_device{}());
+        size_t seen = 0;
+
+        forEachBlock(source, [&](const PointView& block, size_t) {
+            for (size_t i = 0; i < block.rows(); ++i, ++seen) {
+                const double* point = block.row(i);
+                if (seen < capacity) {
+                    sample.insert(sample.end(), point, point + dims_);
+                    continue;
+                }
+                size_t slot = std::uniform_int_distribution<size_t>(0, seen)(rng);
+                if (slot < capacity) std::copy(point, point + dims_, &sample[slot * dims_]);
+            }
+        });
+
+        sampleBytes_ = sample.capacity() * sizeof(double);
+        KMeans<double, Dim> engine(options_);
+        return engine.initialize(PointView(sample.data(), sample.size() / dims_, dims_), k);
+    }
+
+    // Une passe : assignation, sommes par cluster et inertie, bloc par bloc
+    double accumulatePass(PointSource& source, const PointMatrix& centroids) {
+        const size_t k = centroids.rows();
+        sums_.assign(k * dims_, 0.0);
+        counts_.assign(k, 0.0);
+        kernel_.setCentroids(centroids.data(), k, dims_, dims_);
+
+        double inertia = 0.0;
+        forEachBlock(source, [&](const PointView& block, size_t) {
+            const size_t chunks = chunkCount(block.rows());
+            partialSums_.assign(chunks * k * dims_, 0.0);
+            partialCounts_.assign(chunks * k, 0.0);
+            partialCosts_.assign(chunks, 0.0);
+
+            forEachChunk(pool_, block.rows(), [&](size_t c, size_t begin, size_t end) {
+                double* sums = &partialSums_[c * k * dims_];
+                double* counts = &partialCounts_[c * k];
+                std::array<int, kFusedBlock> labels;
+                double cost = 0.0;
+                for (size_t sub = begin; sub < end; sub += kFusedBlock) {
+                    const size_t count = std::min(kFusedBlock, end - sub);
+                    kernel_.template assign<Dim>(block.row(sub), block.stride(), 0, count, labels.data());
+                    for (size_t b = 0; b < count; ++b) {
+                        const double* point = block.row(sub + b);
+                        const int cluster = labels[b];
+                        cost += distanceSquaredFixed<Dim>(point, centroids.row(cluster), dims_);
+                        counts[cluster] += 1.0;
+                        double* sum = sums + cluster * dims_;
+                        for (size_t d = 0; d < dims_; ++d) sum[d] += point[d];
+                    }
+                }
+                partialCosts_[c] = cost;
+            });
+
+            // Fusion dans l'ordre des blocs : même résultat quel que soit le nombre de threads
+            for (size_t c = 0; c < chunks; ++c) {
+                for (size_t j = 0; j < k * dims_; ++j) sums_[j] += partialSums_[c * k * dims_ + j];
+                for (size_t j = 0; j < k; ++j) counts_[j] += partialCounts_[c * k + j];
+                inertia += partialCosts_[c];
+            }
+        });
+        return inertia;
+    }
+
+    // Moyennes des sommes de la passe ; un centroïde sans point garde sa position.
+    // Renvoie le plus grand déplacement d'un centroïde (0 si aucun n'a bougé).
+    double updateCentroids(PointMatrix& centroids) const {
+        double maxShift = 0.0;
+        for (size_t j = 0; j < centroids.rows(); ++j) {
+            if (counts_[j] <= 0.0) continue;
+            double* centroid = centroids.row(j);
+            double shift = 0.0;
+            for (size_t d = 0; d < dims_; ++d) {
+                const double value = sums_[j * dims_ + d] / counts_[j];
+                shift += (value - centroid[d]) * (value - centroid[d]);
+                centroid[d] = value;
+            }
+            maxShift = std::max(maxShift, std::sqrt(shift));
+        }
+        return maxShift;
+    }
+
+    void finishStats(int k) {
+        const size_t chunks = chunkCount(blockRows_);
+        stats_.bufferBytes = (front_.capacity() + back_.capacity()) * sizeof(double) + sampleBytes_ +
+                             (chunks + 1) * (static_cast<size_t>(k) * (dims_ + 1) + 1) * sizeof(double);
+        stats_.peakResidentBytes = peakResidentBytes();
+    }
+
+    KMeansOptions options_;
+    size_t blockRows_;
+    ThreadPool pool_;
+    AssignmentKernel kernel_;
+    size_t dims_ = 0;
+    StreamingStats stats_;
+    size_t sampleBytes_ = 0;
+
+    // Double tampon de lecture
+    std::vector<double> front_;
+    std::vector<double> back_;
+
+    // Sommes de la passe en cours, et sommes par bloc de calcul (réutilisées)
+    std::vector<double> sums_;
+    std::vector<double> counts_;
+    std::vector<double> partialSums_;
+    std::vector<double> partialCounts_;
+    std::vector<double> partialCosts_;
+    std::vector<int> labels_;
+};
+
+} // namespace KMeansLib
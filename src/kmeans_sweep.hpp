@@ -0,0 +1,295 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <ostream>
+#include <random>
+#include <vector>
+#include "kmeans_lib.hpp"
+
+namespace KMeansLib {
+
+// Critère de choix de K dans un balayage
+enum class KSelection {
+    Elbow,        // coude de la courbe d'inertie
+    Silhouette,   // meilleur score silhouette, mesuré sur un échantillon de points
+    Psnr          // plus petit K qui atteint targetPsnr (le balayage s'arrête là)
+};
+
+struct KSweepOptions {
+    int minK = 2;
+    int maxK = 32;
+    int step = 1;                     // clusters ajoutés d'un K au suivant
+    KSelection selection = KSelection::Elbow;
+    double targetPsnr = 0.0;          // Psnr : qualité visée (dB)
+    double peak = 255.0;              // valeur maximale d'une coordonnée, pour le PSNR
+    size_t silhouetteSamples = 2000;  // Silhouette : points tirés (S² distances par K)
+};
+
+// Un point de la courbe : le K-means convergé pour k clusters
+struct KSweepPoint {
+    int k = 0;
+    double inertia = 0.0;
+    double psnr = 0.0;
+    double silhouette = 0.0;          // seulement avec KSelection::Silhouette
+    int iterations = 0;
+    double seconds = 0.0;
+};
+
+struct KSweepResult {
+    int chosenK = 0;
+    bool targetReached = true;        // Psnr : faux si maxK n'atteint pas targetPsnr
+    std::vector<KSweepPoint> curve;
+    KMeansResult best;                // K-means du K choisi (labels de tous les points)
+};
+
+namespace detail {
+
+// Coupe en deux les `count` clusters de plus grande inertie. Chaque cluster est
+// coupé le long de sa coordonnée de plus grande variance : ses deux moitiés
+// partent de c - σ et c + σ (la première remplace c, la seconde est ajoutée à
+// la fin). Les sommes par cluster sont faites par blocs en parallèle. Renvoie
+// moins de nouveaux centroïdes si trop peu de clusters sont divisibles.
+template <typename T>
+PointMatrix splitClusters(const BasicPointView<T>& points, const std::vector<int>& labels,
+                          const WeightView& weights, const PointMatrix& centroids,
+                          int count, ThreadPool& pool) {
+    const size_t k = centroids.rows();
+    const size_t dims = centroids.cols();
+    const size_t stride = 1 + 2 * dims;   // poids, sommes, sommes des carrés
+    std::vector<double> partial(chunkCount(points.rows()) * k * stride, 0.0);
+    forEachChunk(pool, points.rows(), [&](size_t c, size_t begin, size_t end) {
+        double* sums = &partial[c * k * stride];
+        for (size_t i = begin; i < end; ++i) {
+            const double w = weights.empty() ? 1.0 : weights[i];
+            double* cluster = sums + labels[i] * stride;
+            const T* p = points.row(i);
+            cluster[0] += w;
+            for (size_t d = 0; d < dims; ++d) {
+                const double x = static_cast<double>(p[d]);
+                cluster[1 + d] += w * x;
+                cluster[1 + dims + d] += w * x * x;
+            }
+        }
+    });
+    std::vector<double> sums(k * stride, 0.0);
+    for (size_t c = 0; c * k * stride < partial.size(); ++c) {
+        for (size_t e = 0; e < sums.size(); ++e) sums[e] += partial[c * k * stride + e];
+    }
+
+    // Variance par coordonnée ; inertie du cluster = poids x somme des variances
+    std::vector<double> variance(k * dims, 0.0), inertia(k, 0.0);
+    for (size_t j = 0; j < k; ++j) {
+        const double* cluster = &sums[j * stride];
+        if (cluster[0] <= 0.0) continue;
+        for (size_t d = 0; d < dims; ++d) {
+            const double mean = cluster[1 + d] / cluster[0];
+            variance[j * dims + d] = std::max(0.0, cluster[1 + dims + d] / cluster[0] - mean * mean);
+            inertia[j] += cluster[0] * variance[j * dims + d];
+        }
+    }
+    std::vector<size_t> order(k);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return inertia[a] > inertia[b]; });
+
+    PointMatrix out = centroids;
+    for (size_t s = 0; s < order.size() && out.rows() < k + static_cast<size_t>(count); ++s) {
+        const size_t j = order[s];
+        if (inertia[j] <= 0.0) break;
+        const double* v = &variance[j * dims];
+        const size_t axis = std::max_element(v, v + dims) - v;
+        const double sigma = std::sqrt(v[axis]);
+        out.resize(out.rows() + 1);
+        std::copy(out[j], out[j] + dims, out[out.rows() - 1]);
+        out[j][axis] -= sigma;
+        out[out.rows() - 1][axis] += sigma;
+    }
+    return out;
+}
+
+// Silhouette moyenne des points échantillonnés : pour chacun, a = distance
+// moyenne aux autres points de son cluster, b = plus petite distance moyenne
+// aux points d'un autre cluster, s = (b - a) / max(a, b) (0 si seul dans son
+// cluster). Distances euclidiennes entre échantillons, en parallèle.
+inline double sampledSilhouette(const PointMatrix& sample, const std::vector<int>& labels, size_t k,
+                                ThreadPool& pool) {
+    const size_t n = sample.rows();
+    std::vector<double> members(k, 0.0);
+    for (int label : labels) members[label] += 1.0;
+    std::vector<double> scores(n, 0.0);
+    constexpr size_t kBlock = 64;
+    pool.parallelFor((n + kBlock - 1) / kBlock, [&](size_t block) {
+        std::vector<double> sums(k);
+        for (size_t i = block * kBlock; i < std::min(n, (block + 1) * kBlock); ++i) {
+            std::fill(sums.begin(), sums.end(), 0.0);
+            for (size_t j = 0; j < n; ++j) {
+                sums[labels[j]] += std::sqrt(distanceSquared(sample[i], sample[j], sample.cols()));
+            }
+            const size_t own = labels[i];
+            if (members[own] <= 1.0) continue;
+            const double a = sums[own] / (members[own] - 1.0);
+            double b = std::numeric_limits<double>::infinity();
+            for (size_t j = 0; j < k; ++j) {
+                if (j != own && members[j] > 0.0) b = std::min(b, sums[j] / members[j]);
+            }
+            if (std::isfinite(b) && std::max(a, b) > 0.0) scores[i] = (b - a) / std::max(a, b);
+        }
+    });
+    return n ? std::accumulate(scores.begin(), scores.end(), 0.0) / n : 0.0;
+}
+
+// Coude : après normalisation des deux axes sur [0, 1], le point de la courbe
+// le plus au-dessus de la corde qui joint le premier et le dernier point.
+// L'inertie est prise en log : les fortes baisses des petits K n'écrasent pas
+// le coude quand la plage de K est large.
+inline size_t elbowIndex(const std::vector<KSweepPoint>& curve) {
+    if (curve.size() < 3) return 0;
+    auto level = [](const KSweepPoint& p) { return std::log(std::max(p.inertia, 1e-300)); };
+    const KSweepPoint& first = curve.front();
+    const KSweepPoint& last = curve.back();
+    const double drop = level(first) - level(last);
+    if (drop <= 0.0) return 0;
+    size_t best = 0;
+    double bestGap = -std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < curve.size(); ++i) {
+        const double x = double(curve[i].k - first.k) / (last.k - first.k);
+        const double y = (level(first) - level(curve[i])) / drop;
+        if (y - x > bestGap) {
+            bestGap = y - x;
+            best = i;
+        }
+    }
+    return best;
+}
+
+} // namespace detail
+
+// Balayage de K de minK à maxK. Seul le premier K part d'une initialisation
+// (options.seeding) ; chaque K suivant repart des centroïdes convergés du
+// précédent dont les `step` clusters de plus grande inertie sont coupés en
+// deux (comme un K-means bisectif), et ne demande donc que quelques
+// itérations de Lloyd. Les K s'enchaînent : le parallélisme est celui du
+// moteur (options.numThreads) pour les itérations, les découpages et la
+// silhouette. options.algorithm et options.numInit ne sont pas utilisés.
+template <typename T, int Dim = Dynamic>
+KSweepResult sweepK(const BasicPointView<T>& points, const KMeansOptions& options,
+                    const KSweepOptions& sweep, const WeightView& weights = {}) {
+    KSweepResult result;
+    if (points.empty() || sweep.minK <= 0 || sweep.maxK < sweep.minK) return result;
+    KMeans<T, Dim> engine(options);
+    ThreadPool pool(options.numThreads);
+
+    const double totalWeight = weights.empty() ? static_cast<double>(points.rows())
+                                               : std::accumulate(weights.begin(), weights.end(), 0.0);
+    auto psnr = [&](double inertia) {
+        const double mse = inertia / (totalWeight * points.cols());
+        return mse > 0.0 ? 10.0 * std::log10(sweep.peak * sweep.peak / mse)
+                         : std::numeric_limits<double>::infinity();
+    };
+
+    // Échantillon de la silhouette, le même pour tous les K (tiré selon les poids)
+    std::vector<size_t> sampleRows;
+    PointMatrix sample;
+    std::vector<int> sampleLabels;
+    if (sweep.selection == KSelection::Silhouette) {
+        std::mt19937_64 rng(options.seed ? options.seed : std::random_device{}());
+        const size_t count = std::min(sweep.silhouetteSamples, points.rows());
+        std::discrete_distribution<size_t> weighted(weights.begin(), weights.end());
+        std::uniform_int_distribution<size_t> uniform(0, points.rows() - 1);
+        sample = PointMatrix(count, points.cols());
+        for (size_t s = 0; s < count; ++s) {
+            sampleRows.push_back(weights.empty() ? uniform(rng) : weighted(rng));
+            const T* p = points.row(sampleRows.back());
+            for (size_t d = 0; d < points.cols(); ++d) sample[s][d] = static_cast<double>(p[d]);
+        }
+        sampleLabels.resize(count);
+    }
+
+    std::vector<PointMatrix> fitted;
+    std::vector<int> labels;
+    PointMatrix centroids = engine.initialize(points, sweep.minK, weights);
+    for (;;) {
+        const auto start = std::chrono::steady_clock::now();
+        KSweepPoint point;
+        point.k = static_cast<int>(centroids.rows());
+        do {
+            ++point.iterations;
+            engine.iterate(points, centroids, labels, weights);
+        } while (!engine.converged() && point.iterations < options.maxIterations);
+        // Les labels de iterate() précèdent le dernier déplacement des centroïdes :
+        // on réassigne avant l'inertie, la silhouette et le découpage
+        engine.assign(points, centroids, labels);
+        point.inertia = engine.cost(points, centroids, labels, weights);
+        point.psnr = psnr(point.inertia);
+        if (sweep.selection == KSelection::Silhouette) {
+            for (size_t s = 0; s < sampleRows.size(); ++s) sampleLabels[s] = labels[sampleRows[s]];
+            point.silhouette = detail::sampledSilhouette(sample, sampleLabels, centroids.rows(), pool);
+        }
+        point.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.curve.push_back(point);
+        fitted.push_back(centroids);
+
+        if (sweep.selection == KSelection::Psnr && point.psnr >= sweep.targetPsnr) break;
+        const int split = std::min(std::max(1, sweep.step), sweep.maxK - point.k);
+        if (split <= 0) break;
+        PointMatrix next = detail::splitClusters(points, labels, weights, centroids, split, pool);
+        if (next.rows() == centroids.rows()) break;   // plus aucun cluster à couper
+        centroids = std::move(next);
+    }
+
+    size_t chosen = result.curve.size() - 1;
+    if (sweep.selection == KSelection::Elbow) {
+        chosen = detail::elbowIndex(result.curve);
+    } else if (sweep.selection == KSelection::Silhouette) {
+        chosen = std::max_element(result.curve.begin(), result.curve.end(),
+                                  [](const KSweepPoint& a, const KSweepPoint& b) {
+                                      return a.silhouette < b.silhouette;
+                                  }) - result.curve.begin();
+    } else {
+        result.targetReached = result.curve.back().psnr >= sweep.targetPsnr;
+    }
+
+    // Labels du K choisi : une passe d'assignation à ses centroïdes
+    result.chosenK = result.curve[chosen].k;
+    result.best.centroids = std::move(fitted[chosen]);
+    engine.assign(points, result.best.centroids, result.best.assignments);
+    result.best.iterations = result.curve[chosen].iterations;
+    result.best.finalCost = engine.cost(points, result.best.centroids, result.best.assignments, weights);
+    return result;
+}
+
+// Points génériques : moteur spécialisé pour 2, 3 ou 4 dimensions
+inline KSweepResult sweepK(const PointView& points, const KMeansOptions& options,
+                           const KSweepOptions& sweep, const WeightView& weights = {}) {
+    switch (points.cols()) {
+        case 2: return sweepK<double, 2>(points, options, sweep, weights);
+        case 3: return sweepK<double, 3>(points, options, sweep, weights);
+        case 4: return sweepK<double, 4>(points, options, sweep, weights);
+        default: return sweepK<double>(points, options, sweep, weights);
+    }
+}
+
+// Pixels 8 bits (BGR, BGRA, niveaux de gris) lus sans conversion
+inline KSweepResult sweepK(const PixelView& points, const KMeansOptions& options,
+                           const KSweepOptions& sweep, const WeightView& weights = {}) {
+    switch (points.cols()) {
+        case 1: return sweepK<uint8_t, 1>(points, options, sweep, weights);
+        case 3: return sweepK<uint8_t, 3>(points, options, sweep, weights);
+        case 4: return sweepK<uint8_t, 4>(points, options, sweep, weights);
+        default: return sweepK<uint8_t>(points, options, sweep, weights);
+    }
+}
+
+// Courbe au format CSV : une ligne par K
+inline void writeSweepCsv(std::ostream& out, const std::vector<KSweepPoint>& curve) {
+    out << "k,inertia,psnr,silhouette,iterations,seconds\n";
+    for (const KSweepPoint& p : curve) {
+        out << p.k << ',' << p.inertia << ',' << p.psnr << ',' << p.silhouette << ','
+            << p.iterations << ',' << p.seconds << '\n';
+    }
+}
+
+} // namespace KMeansLib
@@ -14,10 +14,14 @@
 // - Affichage des trajectoires des centroïdes
 // - Interface utilisateur avec contrôles (ESC, SPACE)
 // - Support des fichiers CSV pour données personnalisées
+// - Rendu par densité rapide, mode sans fenêtre et export vidéo / PNG
 // ============================================================================
 
 #include <opencv2/opencv.hpp>  // Bibliothèque OpenCV pour l'affichage graphique
 #include <bits/stdc++.h>       // Toutes les bibliothèques standard C++ (pratique mais pas optimal)
+#include "kmeans_lib.hpp"      // Bibliothèque K-means commune
+#include "csv_reader.hpp"      // Lecture CSV rapide (parallèle)
+#include "point_file.hpp"      // Fichiers de points binaires .kmp
 using namespace std;           // Pour éviter std:: partout
 using namespace cv;            // Pour éviter cv:: partout
 
@@ -25,147 +29,16 @@ using namespace cv;            // Pour éviter cv:: partout
 // DÉFINITION DES TYPES PERSONNALISÉS
 // ============================================================================
 
-// Un vecteur 2D représente un point (x, y) dans l'espace
-using Vector2D = vector<double>;
+// L'algorithme K-means vient de la bibliothèque commune (kmeans_lib.hpp).
+// KMeans<double, 2> est spécialisé pour la 2D : le calcul des distances et
+// l'accumulation des centroïdes sont déroulés par le compilateur.
+using KMeans2D = KMeansLib::KMeans<double, 2>;
 
-// Une matrice de données est un ensemble de points 2D
-using MatD = vector<Vector2D>;
+// Un point 2D (x, y), stocké dans un std::array (pas d'allocation par point)
+using Point2D = KMeans2D::Point;
 
-// ============================================================================
-// FONCTIONS UTILITAIRES POUR L'ALGORITHME K-MEANS
-// ============================================================================
-
-/**
- * Calcule la distance euclidienne au carré entre deux points 2D
- * 
- * POURQUOI AU CARRÉ? 
- * - Plus rapide (pas besoin de sqrt())
- * - Préserve l'ordre des distances (important pour trouver le minimum)
- * - Mathématiquement équivalent pour la comparaison
- * 
- * @param a Premier point (x1, y1)
- * @param b Deuxième point (x2, y2)
- * @return Distance au carré: (x2-x1)² + (y2-y1)²
- */
-static inline double l2sq(const Vector2D& a, const Vector2D& b){
-    double s=0.0; // Somme des différences au carré
-    
-    // Parcourt les coordonnées (x, y)
-    for(size_t i=0;i<a.size();++i){ 
-        double d=a[i]-b[i];  // Différence sur cette dimension
-        s+=d*d;              // Ajoute le carré à la somme
-    } 
-    return s; // Retourne la distance euclidienne au carré
-}
-
-/**
- * ÉTAPE 1 de K-means: Assigner chaque point au centroïde le plus proche
- * 
- * PRINCIPE:
- * Pour chaque point, on calcule sa distance à tous les centroïdes
- * et on l'assigne au cluster du centroïde le plus proche.
- * 
- * @param X Matrice des points de données (chaque ligne = un point)
- * @param C Matrice des centroïdes actuels (chaque ligne = un centroïde)
- * @return Vecteur d'assignations (idx[i] = cluster du point i)
- */
-vector<int> find_closest_centroids(const MatD& X, const MatD& C){
-    vector<int> idx(X.size()); // Vecteur pour stocker les assignations
-    
-    // Pour chaque point dans nos données
-    for(size_t i=0;i<X.size();++i){
-        double best = numeric_limits<double>::infinity(); // Distance minimale trouvée
-        int bj=0; // Index du meilleur centroïde
-        
-        // Teste la distance à chaque centroïde
-        for(size_t j=0;j<C.size();++j){ 
-            double d=l2sq(X[i],C[j]); // Distance au carré vers centroïde j
-            if(d<best){               // Si c'est la meilleure distance
-                best=d;               // Mettre à jour la meilleure distance
-                bj=(int)j;            // Mémoriser l'index du centroïde
-            }
-        }
-        idx[i]=bj; // Assigner le point i au centroïde bj
-    }
-    return idx; // Retourner toutes les assignations
-}
-
-/**
- * ÉTAPE 2 de K-means: Recalculer les centroïdes basés sur les assignations
- * 
- * PRINCIPE:
- * Chaque centroïde devient le centre de masse (moyenne) des points
- * qui lui sont assignés. C'est ce qui fait "bouger" les centroïdes
- * vers le centre de leur cluster.
- * 
- * @param X Matrice des points de données
- * @param idx Assignations actuelles (résultat de find_closest_centroids)
- * @param K Nombre de clusters souhaités
- * @return Nouveaux centroïdes calculés
- */
-MatD compute_centroids(const MatD& X, const vector<int>& idx, int K){
-    int n = (int)X[0].size(); // Nombre de dimensions (2 pour 2D)
-    
-    // Initialiser les nouveaux centroïdes à zéro
-    MatD C(K, Vector2D(n,0.0)); 
-    vector<int> cnt(K,0); // Compteur de points par cluster
-    
-    // PHASE 1: Accumuler les coordonnées des points par cluster
-    for(size_t i=0;i<X.size();++i){
-        int k=idx[i];  // Cluster assigné au point i
-        cnt[k]++;      // Incrémenter le compteur pour ce cluster
-        
-        // Ajouter les coordonnées du point au centroïde
-        for(int t=0;t<n;++t) {
-            C[k][t]+=X[i][t]; // Accumulation des coordonnées
-        }
-    }
-    
-    // PHASE 2: Diviser par le nombre de points pour obtenir la moyenne
-    for(int k=0;k<K;++k) {
-        if(cnt[k]) { // Si le cluster a des points assignés
-            for(int t=0;t<n;++t) {
-                C[k][t]/=cnt[k]; // Moyenne = somme / nombre de points
-            }
-        }
-        // ATTENTION: Si cnt[k] == 0, le centroïde reste à (0,0)
-        // Dans un vrai projet, il faudrait gérer ce cas edge
-    }
-    return C; // Retourner les nouveaux centroïdes
-}
-
-/**
- * Initialise les centroïdes de manière aléatoire
- * 
- * STRATÉGIE D'INITIALISATION:
- * Au lieu de placer les centroïdes au hasard, on choisit K points
- * aléatoires parmi nos données. Cette méthode donne généralement
- * de meilleurs résultats que l'initialisation complètement aléatoire.
- * 
- * @param X Données d'entrée
- * @param K Nombre de centroïdes à initialiser
- * @param seed Graine pour la génération aléatoire (0 = aléatoire)
- * @return Centroïdes initialisés
- */
-MatD init_centroids(const MatD& X, int K, uint64_t seed=0){
-    // Si pas de graine fournie, en générer une aléatoire
-    if(seed == 0) seed = std::random_device{}();
-    
-    // Créer un vecteur d'indices [0, 1, 2, ..., n-1]
-    vector<int> perm(X.size()); 
-    iota(perm.begin(),perm.end(),0); // Remplit avec 0,1,2,...
-    
-    // Mélanger les indices de manière aléatoire
-    mt19937_64 rng(seed);           // Générateur de nombres aléatoires
-    shuffle(perm.begin(),perm.end(),rng); // Mélange aléatoire
-    
-    // Prendre les K premiers indices mélangés comme centroïdes initiaux
-    MatD C(K); 
-    for(int k=0;k<K;++k) {
-        C[k]=X[perm[k]]; // Copier le point à l'index aléatoire
-    }
-    return C;
-}
+// Les centroïdes sont une matrice dense K x 2
+using KMeansLib::PointMatrix;
 
 // ============================================================================
 // STRUCTURES ET FONCTIONS POUR LA VISUALISATION
@@ -189,7 +62,7 @@ struct MinMax{
  * @param X Ensemble des points 2D
  * @return Limites min/max en x et y
  */
-MinMax bounds2D(const MatD& X){
+MinMax bounds2D(const vector<Point2D>& X){
     // Initialiser avec les valeurs extrêmes
     MinMax mm{
         numeric_limits<double>::infinity(),    // minx = +∞
@@ -223,29 +96,34 @@ MinMax bounds2D(const MatD& X){
  * x_écran = pad + (x_données - minx) * échelle_x
  * y_écran = H - (pad + (y_données - miny) * échelle_y)  [y inversé!]
  * 
- * @param p Point en coordonnées de données
- * @param mm Limites des données  
- * @param W Largeur de la fenêtre
- * @param H Hauteur de la fenêtre
- * @param pad Marge autour du graphique
- * @return Point en coordonnées d'écran
+ * Les facteurs d'échelle ne dépendent que des limites et de la taille de la
+ * fenêtre : ils sont calculés une seule fois à la construction, pas à
+ * chaque point.
  */
-Point2i toCanvas(const Vector2D& p, const MinMax& mm, int W, int H, int pad=40){
-    // Calcul des facteurs d'échelle
-    double sx=(W-2*pad)/(mm.maxx-mm.minx);  // Échelle horizontale
-    double sy=(H-2*pad)/(mm.maxy-mm.miny);  // Échelle verticale
-    
-    // Transformation des coordonnées
-    double x = pad + (p[0]-mm.minx)*sx;           // Position x à l'écran
-    double y = H - (pad + (p[1]-mm.miny)*sy);     // Position y à l'écran (inversée)
-    
-    // POURQUOI Y INVERSÉ?
-    // Dans les maths: y augmente vers le haut
-    // À l'écran: y augmente vers le bas
-    // Donc on fait H - y pour corriger
-    
-    return Point2i((int)round(x),(int)round(y));  // Convertir en pixels entiers
-}
+struct CanvasTransform {
+    double minx, miny;   // Coin bas-gauche des données
+    double sx, sy;       // Échelles horizontale et verticale
+    int H, pad;          // Hauteur de la fenêtre et marge
+
+    CanvasTransform(const MinMax& mm, int W, int H, int pad=40)
+        : minx(mm.minx), miny(mm.miny),
+          sx((W-2*pad)/(mm.maxx-mm.minx)), sy((H-2*pad)/(mm.maxy-mm.miny)),
+          H(H), pad(pad) {}
+
+    // @param p Point en coordonnées de données (p[0] = x, p[1] = y)
+    // @return Point en coordonnées d'écran (pixels entiers)
+    Point2i operator()(const double* p) const {
+        double x = pad + (p[0]-minx)*sx;           // Position x à l'écran
+        double y = H - (pad + (p[1]-miny)*sy);     // Position y à l'écran (inversée)
+
+        // POURQUOI Y INVERSÉ?
+        // Dans les maths: y augmente vers le haut
+        // À l'écran: y augmente vers le bas
+        // Donc on fait H - y pour corriger
+
+        return Point2i((int)round(x),(int)round(y));
+    }
+};
 
 /**
  * Palette de 30 couleurs distinctes pour visualiser les clusters
@@ -322,6 +200,153 @@ void drawCross(Mat& img, Point c, Scalar col, int size=8, int thickness=2){
     // LINE_AA = antialiasing pour des lignes plus lisses
 }
 
+// ============================================================================
+// RENDU PAR DENSITÉ (rapide, sans fenêtre possible, export vidéo / PNG)
+// ============================================================================
+
+/**
+ * Moteur de rendu des points par "splatting" de densité
+ *
+ * POURQUOI?
+ * Dessiner un cercle anti-aliasé par point et par frame coûte des secondes
+ * avec 1M+ points. Or les points ne bougent jamais : seule leur couleur
+ * (leur cluster) change d'une itération à l'autre.
+ *
+ * PRINCIPE:
+ * - Le pixel de chaque point (et l'empreinte de son disque de rayon r) est
+ *   calculé une seule fois, à la construction
+ * - Chaque pixel accumule le nombre de points qui le couvrent et la somme de
+ *   leurs couleurs : il affiche leur couleur moyenne, d'autant plus opaque que
+ *   la densité est forte (échelle logarithmique, fixée une fois pour toutes)
+ * - L'image est découpée en bandes de lignes traitées en parallèle : chaque
+ *   bande ne modifie que ses propres pixels, sans verrou
+ * - Rendu incrémental : seuls les points qui ont changé de cluster depuis la
+ *   frame précédente sont retirés puis rajoutés avec leur nouvelle couleur,
+ *   et seuls leurs pixels sont recalculés
+ */
+class DensityRenderer {
+public:
+    static constexpr int kBandRows = 32;   // Lignes par bande parallèle
+
+    DensityRenderer(const vector<Point2D>& X, const CanvasTransform& toScreen, int W, int H,
+                    int K, int radius, KMeansLib::ThreadPool& pool)
+        : W_(W), H_(H), pool_(pool), bands_((H + kBandRows - 1) / kBandRows),
+          count_(static_cast<size_t>(W) * H, 0), alpha_(count_.size(), 0.0f),
+          sums_(count_.size() * 3, 0), shown_(X.size(), -1),
+          layer_(H, W, CV_8UC3, kBackground) {
+        // Empreinte d'un point : disque de rayon r (un seul pixel si r = 0)
+        for(int dy=-radius; dy<=radius; ++dy){
+            for(int dx=-radius; dx<=radius; ++dx){
+                if(dx*dx+dy*dy <= radius*radius+radius) footprint_.push_back({dx,dy});
+            }
+        }
+
+        // Coordonnées écran précalculées, et points de chaque bande (un point
+        // dont le disque chevauche deux bandes est dans les deux)
+        centers_.resize(X.size());
+        bandPoints_.resize(bands_);
+        for(size_t i=0;i<X.size();++i){
+            centers_[i] = toScreen(X[i].data());
+            int first = max(0, centers_[i].y - radius), last = min(H-1, centers_[i].y + radius);
+            for(int b = first / kBandRows; first <= last && b <= last / kBandRows; ++b){
+                bandPoints_[b].push_back(static_cast<uint32_t>(i));
+            }
+        }
+
+        // Densité de chaque pixel : fixe, donc l'opacité aussi
+        forEachPixel([&](size_t, size_t pixel){ ++count_[pixel]; });
+        const uint32_t maxCount = *max_element(count_.begin(), count_.end());
+        const float scale = maxCount > 1 ? 1.0f / log1p(static_cast<float>(maxCount)) : 1.0f;
+        for(size_t pixel=0; pixel<count_.size(); ++pixel){
+            if(count_[pixel]) alpha_[pixel] = min(1.0f, 0.6f + 0.4f * log1p(static_cast<float>(count_[pixel])) * scale);
+        }
+
+        for(int k=0;k<K;++k){
+            Scalar c = colorFromIdx(k);
+            palette_.push_back({(int)c[0], (int)c[1], (int)c[2]});
+        }
+    }
+
+    /**
+     * Met à jour la couche des points pour les nouveaux labels
+     * @return Nombre de points redessinés (ceux qui ont changé de cluster)
+     */
+    size_t update(const vector<int>& labels){
+        pool_.parallelFor(bands_, [&](size_t band){
+            const int rowBegin = static_cast<int>(band) * kBandRows;
+            const int rowEnd = min(H_, rowBegin + kBandRows);
+            vector<size_t> dirty;
+            for(uint32_t i : bandPoints_[band]){
+                const int before = shown_[i], now = labels[i];
+                if(before == now) continue;
+                for(const Point& offset : footprint_){
+                    const int x = centers_[i].x + offset.x, y = centers_[i].y + offset.y;
+                    if(y < rowBegin || y >= rowEnd || x < 0 || x >= W_) continue;
+                    const size_t pixel = static_cast<size_t>(y) * W_ + x;
+                    int64_t* sum = &sums_[pixel*3];
+                    for(int c=0;c<3;++c){
+                        if(before >= 0) sum[c] -= palette_[before][c];
+                        sum[c] += palette_[now][c];
+                    }
+                    dirty.push_back(pixel);
+                }
+            }
+            for(size_t pixel : dirty) shade(pixel);
+        });
+
+        size_t changed = 0;
+        for(size_t i=0;i<labels.size();++i){
+            changed += labels[i] != shown_[i];
+            shown_[i] = labels[i];
+        }
+        return changed;
+    }
+
+    // Couche des points (fond + densité), sans centroïdes ni texte
+    const Mat& layer() const { return layer_; }
+
+private:
+    static inline const Scalar kBackground = Scalar(30,30,30);
+
+    // fn(i, pixel) pour chaque pixel couvert par le point i, bande par bande
+    template <typename Fn>
+    void forEachPixel(Fn&& fn){
+        pool_.parallelFor(bands_, [&](size_t band){
+            const int rowBegin = static_cast<int>(band) * kBandRows;
+            const int rowEnd = min(H_, rowBegin + kBandRows);
+            for(uint32_t i : bandPoints_[band]){
+                for(const Point& offset : footprint_){
+                    const int x = centers_[i].x + offset.x, y = centers_[i].y + offset.y;
+                    if(y >= rowBegin && y < rowEnd && x >= 0 && x < W_) fn(i, static_cast<size_t>(y) * W_ + x);
+                }
+            }
+        });
+    }
+
+    // Couleur affichée : moyenne des couleurs du pixel, mélangée au fond
+    void shade(size_t pixel){
+        const int64_t* sum = &sums_[pixel*3];
+        uchar* out = layer_.ptr<uchar>(static_cast<int>(pixel / W_)) + (pixel % W_) * 3;
+        for(int c=0;c<3;++c){
+            const float mean = static_cast<float>(sum[c]) / count_[pixel];
+            out[c] = saturate_cast<uchar>(kBackground[c] + (mean - kBackground[c]) * alpha_[pixel]);
+        }
+    }
+
+    int W_, H_;
+    KMeansLib::ThreadPool& pool_;
+    size_t bands_;
+    vector<Point> footprint_;               // Décalages (dx, dy) du disque d'un point
+    vector<Point> centers_;                 // Pixel de chaque point
+    vector<vector<uint32_t>> bandPoints_;   // Points qui touchent chaque bande
+    vector<uint32_t> count_;                // Points qui couvrent chaque pixel
+    vector<float> alpha_;                   // Opacité de chaque pixel
+    vector<int64_t> sums_;                  // Somme des couleurs BGR par pixel
+    vector<int> shown_;                     // Label affiché de chaque point (-1 = aucun)
+    vector<array<int,3>> palette_;          // Couleur BGR de chaque cluster
+    Mat layer_;
+};
+
 // ============================================================================
 // FONCTION PRINCIPALE - PROGRAMME INTERACTIF K-MEANS 2D
 // ============================================================================
@@ -342,17 +367,57 @@ int main(int argc, char** argv){
     // ========================================================================
     
     // Dataset 2D avec beaucoup de clusters ou CSV (x,y) optionnel
-    // Usage: kmeans_visual_2d [K=8] [iters=15] [csv_path]
+    // Usage: kmeans_visual_2d [options] [K=8] [iters=15] [csv_path]
+    // Les options (--headless, --video...) sont retirées avant de lire les
+    // arguments positionnels
     
-    int K = (argc>=2? stoi(argv[1]) : 8);      // Nombre de clusters (défaut: 8)
-    int iters = (argc>=3? stoi(argv[2]) : 15); // Nombre max d'itérations (défaut: 15)
-    string csv = (argc>=4? argv[3] : "");      // Fichier CSV optionnel
+    bool headless = false;        // Pas de fenêtre (serveur, benchmark)
+    string framesDir, videoPath;  // Export PNG (un fichier par frame) / vidéo
+    double fps = 10.0;            // Images par seconde de la vidéo exportée
+    int W=900, H=700;             // Taille des frames
+    int pointSize = -1;           // Rayon des points en pixels (-1 = selon N)
+    int delay = 1800;             // Pause entre deux frames affichées (ms)
+    int threads = 0;              // Threads K-means et rendu (0 = tous les coeurs)
+    vector<string> positional;
+    for(int i=1;i<argc;++i){
+        string arg = argv[i];
+        if(arg=="--headless") headless = true;
+        else if(arg=="--frames" && i+1<argc) framesDir = argv[++i];
+        else if(arg=="--video" && i+1<argc) videoPath = argv[++i];
+        else if(arg=="--fps" && i+1<argc) fps = stod(argv[++i]);
+        else if(arg=="--size" && i+1<argc){
+            if(sscanf(argv[++i], "%dx%d", &W, &H) != 2 || W < 100 || H < 100){
+                cerr << "❌ Erreur: --size attend LARGEURxHAUTEUR (au moins 100x100)\n";
+                return 1;
+            }
+        }
+        else if(arg=="--point-size" && i+1<argc) pointSize = max(0, stoi(argv[++i]));
+        else if(arg=="--delay" && i+1<argc) delay = max(1, stoi(argv[++i]));
+        else if(arg=="--threads" && i+1<argc) threads = stoi(argv[++i]);
+        else if(arg=="--help" || arg=="-h"){
+            cout << "Usage: " << argv[0] << " [options] [K=8] [iterations=15] [points.csv|points.kmp]\n"
+                 << "  --headless: no window, render frames only (export and/or timing)\n"
+                 << "  --frames DIR: write every frame as DIR/frame_NNNN.png\n"
+                 << "  --video FILE: write frames to a video (.avi = MJPG, otherwise mp4v)\n"
+                 << "  --fps N: exported video frame rate (default: 10)\n"
+                 << "  --size WxH: frame size (default: 900x700)\n"
+                 << "  --point-size R: point radius in pixels (default: 3, 1 or 0 depending on N)\n"
+                 << "  --delay MS: pause between displayed frames (default: 1800)\n"
+                 << "  --threads N: K-means and rendering threads, 0 = all cores (default: 0)\n";
+            return 0;
+        }
+        else positional.push_back(arg);
+    }
+
+    int K = (positional.size()>=1? stoi(positional[0]) : 8);      // Nombre de clusters (défaut: 8)
+    int iters = (positional.size()>=2? stoi(positional[1]) : 15); // Nombre max d'itérations (défaut: 15)
+    string csv = (positional.size()>=3? positional[2] : "");      // Fichier CSV ou .kmp optionnel
 
     // ========================================================================
     // GÉNÉRATION OU CHARGEMENT DES DONNÉES
     // ========================================================================
     
-    MatD X; // Matrice qui contiendra tous nos points 2D
+    vector<Point2D> X; // Tableau qui contiendra tous nos points 2D
     
     if(csv.empty()){
         // ====================================================================
@@ -404,42 +469,51 @@ int main(int argc, char** argv){
         
         cout << "Généré " << X.size() << " points répartis en 8 clusters + bruit\n";
         
+    } else if(KMeansLib::isPointFile(csv)) {
+        // ====================================================================
+        // MODE FICHIER BINAIRE: fichier .kmp projeté en mémoire (kmeans_convert)
+        // ====================================================================
+
+        KMeansLib::MappedPointFile file(csv);
+        if(file.dims() != 2){
+            cerr << "❌ Erreur: " << csv << " contient des points de dimension " << file.dims() << "\n";
+            return 1;
+        }
+        X.resize(file.count());
+        file.read(X.empty() ? nullptr : X[0].data(), X.size()); // Point2D = 2 doubles contigus
+        cout << "✅ Chargé " << X.size() << " points depuis " << csv << "\n";
+
     } else {
         // ====================================================================
         // MODE FICHIER: Chargement depuis un CSV
         // ====================================================================
         
         cout << "Chargement des données depuis: " << csv << "\n";
-        
-        ifstream f(csv);
-        if(!f){ 
-            cerr<<"❌ Erreur: Impossible de lire " << csv << "\n"; 
-            return 1; 
+
+        // Lecteur CSV de la bibliothèque : analyse en parallèle (std::from_chars),
+        // les lignes invalides sont comptées au lieu d'être affichées une par une
+        KMeansLib::CsvOptions options;
+        options.numThreads = 0;
+        KMeansLib::CsvResult parsed;
+        try {
+            parsed = KMeansLib::readCsv(csv, options);
+        } catch(const exception& e) {
+            cerr << "❌ Erreur: " << e.what() << "\n";
+            return 1;
         }
-        
-        string line;
-        int lineNum = 0;
-        
-        // Lecture ligne par ligne du fichier CSV
-        while(getline(f,line)){
-            lineNum++;
-            if(line.empty()) continue; // Ignorer les lignes vides
-            
-            stringstream ss(line);
-            string a,b; // Coordonnées x et y sous forme de chaînes
-            
-            // Séparer par virgules: "x,y"
-            if(!getline(ss,a,',')) continue; // Lire jusqu'à la première virgule
-            if(!getline(ss,b,',')) continue; // Lire jusqu'à la deuxième virgule
-            
-            try {
-                // Convertir les chaînes en nombres
-                double x = stod(a); // string to double
-                double y = stod(b);
-                X.push_back({x, y});
-            } catch(const exception& e) {
-                cerr << "⚠️  Ligne " << lineNum << " ignorée (format invalide): " << line << "\n";
-            }
+        if(parsed.malformedLines){
+            cerr << "⚠️  " << parsed.malformedLines << " ligne(s) ignorée(s) (format invalide), dont la ligne "
+                 << parsed.malformedSamples[0] << "\n";
+        }
+        if(!parsed.points.empty() && parsed.points.cols() < 2){
+            cerr << "❌ Erreur: il faut au moins deux colonnes (x, y)\n";
+            return 1;
+        }
+
+        // Seules les deux premières colonnes (x, y) sont utilisées
+        X.reserve(parsed.points.rows());
+        for(size_t i=0;i<parsed.points.rows();++i){
+            X.push_back({parsed.points[i][0], parsed.points[i][1]});
         }
         
         if(X.empty()){ 
@@ -450,37 +524,63 @@ int main(int argc, char** argv){
         cout << "✅ Chargé " << X.size() << " points depuis " << csv << "\n";
     }
 
-    auto C = init_centroids(X, K);
+    KMeansLib::KMeansOptions options;
+    options.numThreads = threads;
+    KMeans2D engine(options);            // Moteur K-means 2D
+    auto view = KMeans2D::view(X);       // Vue sans copie sur les points
+    PointMatrix C = engine.initialize(view, K);
     vector<int> idx(X.size(),0);
 
-    const int W=900, H=700;
     MinMax mm = bounds2D(X);
+    CanvasTransform toScreen(mm, W, H);  // Échelles calculées une seule fois
 
-    Mat canvas(H,W,CV_8UC3, Scalar(30,30,30));
-    vector<MatD> history; history.push_back(C);
+    // Rendu par densité : les coordonnées écran sont précalculées ici
+    if(pointSize < 0) pointSize = X.size() <= 20000 ? 3 : (X.size() <= 200000 ? 1 : 0);
+    KMeansLib::ThreadPool pool(threads);
+    DensityRenderer renderer(X, toScreen, W, H, K, pointSize, pool);
+
+    // Sorties: fenêtre, séquence PNG et/ou vidéo
+    if(!framesDir.empty()) filesystem::create_directories(framesDir);
+    VideoWriter video;
+    if(!videoPath.empty()){
+        bool avi = videoPath.size() >= 4 && videoPath.compare(videoPath.size()-4, 4, ".avi") == 0;
+        int fourcc = avi ? VideoWriter::fourcc('M','J','P','G') : VideoWriter::fourcc('m','p','4','v');
+        if(!video.open(videoPath, fourcc, fps, Size(W,H))){
+            cerr << "❌ Erreur: impossible de créer la vidéo " << videoPath << "\n";
+            return 1;
+        }
+    }
+
+    vector<PointMatrix> history; history.push_back(C);
+    Mat frame;
+    using Clock = chrono::steady_clock;
+    auto seconds = [](Clock::time_point start){ return chrono::duration<double>(Clock::now()-start).count(); };
+    double kmeansSeconds = 0, renderSeconds = 0, exportSeconds = 0;
+    size_t redrawn = 0;
+    int frames = 0;
 
     for(int it=0; it<iters; ++it){
-        idx = find_closest_centroids(X, C);
-        Mat frame(H,W,CV_8UC3, Scalar(30,30,30));
+        auto start = Clock::now();
+        engine.assign(view, C, idx);
+        kmeansSeconds += seconds(start);
 
-        // points
-        for(size_t i=0;i<X.size();++i){
-            Point2i p = toCanvas(X[i], mm, W,H);
-            circle(frame, p, 3, colorFromIdx(idx[i]), FILLED, LINE_AA);
-        }
+        // points : seuls ceux qui ont changé de cluster sont redessinés
+        start = Clock::now();
+        redrawn += renderer.update(idx);
+        frame = renderer.layer().clone();
 
         // liens centroides (trajectoire)
         for(size_t h=1; h<history.size(); ++h){
             for(int k=0;k<K;++k){
-                Point2i p1 = toCanvas(history[h-1][k], mm,W,H);
-                Point2i p2 = toCanvas(history[h][k],   mm,W,H);
+                Point2i p1 = toScreen(history[h-1][k]);
+                Point2i p2 = toScreen(history[h][k]);
                 line(frame, p1, p2, Scalar(255,255,255), 1, LINE_AA);
             }
         }
 
         // centroides courants
         for(int k=0;k<K;++k){
-            Point2i pc = toCanvas(C[k], mm,W,H);
+            Point2i pc = toScreen(C[k]);
             drawCross(frame, pc, Scalar(255,255,255), 8, 2);
         }
 
@@ -489,23 +589,56 @@ int main(int argc, char** argv){
                 Point(20,40), FONT_HERSHEY_SIMPLEX, 1.0, Scalar(255,255,255), 2, LINE_AA);
         putText(frame, "Clusters K="+to_string(K)+" | Points: "+to_string(X.size()), 
                 Point(20,80), FONT_HERSHEY_SIMPLEX, 0.7, Scalar(200,200,200), 2, LINE_AA);
-        putText(frame, "ESC pour quitter | SPACE pour pause", Point(20,H-40), 
-                FONT_HERSHEY_SIMPLEX, 0.6, Scalar(200,200,200), 1, LINE_AA);
-        imshow("K-means 2D Visualizer - Multi-Clusters", frame);
-        int key = waitKey(1800); // 1.8 secondes
-        if(key==27) break; // ESC pour quitter
-        if(key==32) waitKey(0); // SPACE pour pause
+        if(!headless){
+            putText(frame, "ESC pour quitter | SPACE pour pause", Point(20,H-40), 
+                    FONT_HERSHEY_SIMPLEX, 0.6, Scalar(200,200,200), 1, LINE_AA);
+        }
+        renderSeconds += seconds(start);
+        ++frames;
+
+        start = Clock::now();
+        if(!framesDir.empty()){
+            char name[32];
+            snprintf(name, sizeof(name), "frame_%04d.png", it+1);
+            if(!imwrite((filesystem::path(framesDir) / name).string(), frame)){
+                cerr << "❌ Erreur: impossible d'écrire " << name << " dans " << framesDir << "\n";
+                return 1;
+            }
+        }
+        if(video.isOpened()) video.write(frame);
+        exportSeconds += seconds(start);
+
+        if(!headless){
+            imshow("K-means 2D Visualizer - Multi-Clusters", frame);
+            int key = waitKey(delay); // 1.8 secondes par défaut
+            if(key==27) break; // ESC pour quitter
+            if(key==32) waitKey(0); // SPACE pour pause
+        }
 
         // update centroids
-        auto newC = compute_centroids(X, idx, K);
-        history.push_back(newC);
-        C.swap(newC);
+        start = Clock::now();
+        engine.update(view, idx, C);
+        kmeansSeconds += seconds(start);
+        history.push_back(C);
     }
+    if(video.isOpened()) video.release();
+
+    // Débit du rendu (hors K-means et hors encodage des fichiers)
+    cout << "Rendu: " << frames << " frames en " << renderSeconds << " s ("
+         << (renderSeconds > 0 ? frames / renderSeconds : 0.0) << " frames/s, "
+         << (frames ? redrawn / frames : 0) << " points redessinés par frame en moyenne)\n";
+    cout << "K-means: " << kmeansSeconds << " s";
+    if(!framesDir.empty() || !videoPath.empty()) cout << " | export: " << exportSeconds << " s";
+    cout << "\n";
+    if(!framesDir.empty()) cout << "Frames PNG: " << framesDir << "\n";
+    if(!videoPath.empty()) cout << "Vidéo: " << videoPath << "\n";
 
     // Affiche la dernière frame jusqu'à touche
-    putText(canvas, "Termine - Appuyez sur une touche", Point(20,H-20),
-            FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255,255,255), 2, LINE_AA);
-    imshow("K-means 2D Visualizer", canvas);
-    waitKey(0);
+    if(!headless && !frame.empty()){
+        putText(frame, "Termine - Appuyez sur une touche", Point(20,H-20),
+                FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255,255,255), 2, LINE_AA);
+        imshow("K-means 2D Visualizer - Multi-Clusters", frame);
+        waitKey(0);
+    }
     return 0;
 }
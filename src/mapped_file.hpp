@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define KMEANS_HAVE_MMAP 1
+#endif
+
+namespace KMeansLib {
+
+// Fichier projeté en mémoire en lecture seule (mmap) : seules les pages
+// effectivement lues sont chargées par le système. Sans mmap, le fichier est lu
+// entièrement en mémoire.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef KMEANS_HAVE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("MappedFile: impossible d'ouvrir " + path);
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("MappedFile: impossible de lire la taille de " + path);
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ > 0) {
+            void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("MappedFile: mmap impossible pour " + path);
+            }
+            data_ = static_cast<const char*>(mapped);
+        }
+        ::close(fd);
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("MappedFile: impossible d'ouvrir " + path);
+        fallback_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data_ = fallback_.data();
+        size_ = fallback_.size();
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef KMEANS_HAVE_MMAP
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifndef KMEANS_HAVE_MMAP
+    std::vector<char> fallback_;
+#endif
+};
+
+} // namespace KMeansLib
@@ -0,0 +1,274 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "kmeans_lib.hpp"
+#include "kmeans_stream.hpp"
+#include "mapped_file.hpp"
+
+namespace KMeansLib {
+
+// Format binaire de points (.kmp), little-endian :
+//
+//   octets  0-3   "KMPT"
+//   octets  4-7   version (1)
+//   octets  8-11  dimension
+//   octets 12-15  type des coordonnées (PointType)
+//   octets 16-19  drapeaux (bit 0 : poids présents)
+//   octets 20-23  réservé (0)
+//   octets 24-31  nombre de points
+//   octets 32-    coordonnées ligne par ligne (count x dims), complétées à 8 octets
+//   puis          poids en double (count), si le drapeau est présent
+//
+// Les coordonnées commencent à un offset aligné : un fichier projeté en mémoire
+// (mmap) se lit directement comme un BasicPointView, sans copie ni conversion.
+enum class PointType : uint32_t {
+    Float64 = 0,
+    Float32 = 1,
+    UInt8 = 2
+};
+
+constexpr char kPointFileMagic[4] = {'K', 'M', 'P', 'T'};
+constexpr uint32_t kPointFileVersion = 1;
+constexpr uint32_t kPointFileHasWeights = 1;
+constexpr size_t kPointFileHeaderSize = 32;
+
+struct PointFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t dims;
+    uint32_t type;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t count;
+};
+static_assert(sizeof(PointFileHeader) == kPointFileHeaderSize, "en-tête .kmp sur 32 octets");
+
+inline size_t pointTypeSize(PointType type) {
+    switch (type) {
+        case PointType::Float64: return sizeof(double);
+        case PointType::Float32: return sizeof(float);
+        case PointType::UInt8: return sizeof(uint8_t);
+    }
+    throw std::invalid_argument("PointType inconnu");
+}
+
+inline const char* pointTypeName(PointType type) {
+    switch (type) {
+        case PointType::Float64: return "float64";
+        case PointType::Float32: return "float32";
+        case PointType::UInt8: return "uint8";
+    }
+    return "?";
+}
+
+template <typename T> struct PointTypeOf;
+template <> struct PointTypeOf<double> { static constexpr PointType value = PointType::Float64; };
+template <> struct PointTypeOf<float> { static constexpr PointType value = PointType::Float32; };
+template <> struct PointTypeOf<uint8_t> { static constexpr PointType value = PointType::UInt8; };
+
+// Taille des coordonnées, complétée pour que les poids restent alignés sur 8 octets.
+// Lève une exception si elle dépasse ce que size_t peut compter (en-tête forgé).
+inline size_t pointPayloadBytes(const PointFileHeader& header) {
+    const size_t rowBytes = static_cast<size_t>(header.dims) * pointTypeSize(static_cast<PointType>(header.type));
+    if (rowBytes != 0 && header.count > (SIZE_MAX - 7) / rowBytes) {
+        throw std::runtime_error("PointFile: taille des points hors limites");
+    }
+    size_t bytes = header.count * rowBytes;
+    return (bytes + 7) & ~size_t(7);
+}
+
+// Écriture séquentielle d'un fichier .kmp : le nombre de points est inscrit dans
+// l'en-tête à la fermeture, les poids (gardés en mémoire) sont écrits à la fin.
+class PointFileWriter {
+public:
+    PointFileWriter(const std::string& path, size_t dims, PointType type, bool withWeights = false)
+        : file_(std::fopen(path.c_str(), "wb")), dims_(dims), type_(type), withWeights_(withWeights) {
+        if (!file_) {
+            throw std::runtime_error("PointFileWriter: impossible de créer " + path);
+        }
+        writeHeader();
+        row_.resize(dims_ * pointTypeSize(type_));
+    }
+
+    ~PointFileWriter() {
+        if (file_) {
+            try { close(); } catch (...) {}
+        }
+    }
+
+    PointFileWriter(const PointFileWriter&) = delete;
+    PointFileWriter& operator=(const PointFileWriter&) = delete;
+
+    size_t count() const { return count_; }
+
+    // Ajoute un point (dims coordonnées converties vers le type du fichier)
+    void append(const double* point, double weight = 1.0) {
+        switch (type_) {
+            case PointType::Float64: std::memcpy(row_.data(), point, row_.size()); break;
+            case PointType::Float32: convertRow<float>(point); break;
+            case PointType::UInt8: convertRow<uint8_t>(point); break;
+        }
+        write(row_.data(), row_.size());
+        if (withWeights_) weights_.push_back(weight);
+        ++count_;
+    }
+
+    void close() {
+        if (!file_) return;
+        const size_t payload = count_ * row_.size();
+        static const char zeros[8] = {};
+        write(zeros, ((payload + 7) & ~size_t(7)) - payload);
+        if (withWeights_) write(weights_.data(), weights_.size() * sizeof(double));
+        std::fseek(file_, 0, SEEK_SET);
+        writeHeader();
+        bool failed = std::fclose(file_) != 0;
+        file_ = nullptr;
+        if (failed) throw std::runtime_error("PointFileWriter: erreur d'écriture");
+    }
+
+private:
+    template <typename T>
+    void convertRow(const double* point) {
+        T* out = reinterpret_cast<T*>(row_.data());
+        for (size_t d = 0; d < dims_; ++d) {
+            if (std::is_integral<T>::value) {
+                double clamped = std::min(255.0, std::max(0.0, std::round(point[d])));
+                out[d] = static_cast<T>(clamped);
+            } else {
+                out[d] = static_cast<T>(point[d]);
+            }
+        }
+    }
+
+    void writeHeader() {
+        PointFileHeader header{};
+        std::memcpy(header.magic, kPointFileMagic, 4);
+        header.version = kPointFileVersion;
+        header.dims = static_cast<uint32_t>(dims_);
+        header.type = static_cast<uint32_t>(type_);
+        header.flags = withWeights_ ? kPointFileHasWeights : 0;
+        header.count = count_;
+        write(&header, sizeof(header));
+    }
+
+    void write(const void* data, size_t bytes) {
+        if (bytes && std::fwrite(data, 1, bytes, file_) != bytes) {
+            throw std::runtime_error("PointFileWriter: erreur d'écriture");
+        }
+    }
+
+    std::FILE* file_;
+    size_t dims_;
+    PointType type_;
+    bool withWeights_;
+    size_t count_ = 0;
+    std::vector<char> row_;
+    std::vector<double> weights_;
+};
+
+// Lecture d'un fichier .kmp projeté en mémoire (MappedFile). view<T>() pointe
+// directement dans la projection : aucune copie, seules les pages effectivement
+// lues sont chargées par le système.
+class MappedPointFile : public PointSource {
+public:
+    explicit MappedPointFile(const std::string& path) : file_(path), data_(file_.data()) {
+        validate(path);
+    }
+
+    MappedPointFile(const MappedPointFile&) = delete;
+    MappedPointFile& operator=(const MappedPointFile&) = delete;
+
+    size_t dims() const override { return header_.dims; }
+    size_t count() const { return header_.count; }
+    PointType type() const { return static_cast<PointType>(header_.type); }
+    bool hasWeights() const { return header_.flags & kPointFileHasWeights; }
+
+    // Vue sans copie sur les coordonnées ; T doit correspondre au type du fichier
+    template <typename T>
+    BasicPointView<T> view() const {
+        if (type() != PointTypeOf<T>::value) {
+            throw std::invalid_argument(std::string("MappedPointFile: les points sont en ") +
+                                        pointTypeName(type()));
+        }
+        return BasicPointView<T>(reinterpret_cast<const T*>(data_ + kPointFileHeaderSize),
+                                 header_.count, header_.dims);
+    }
+
+    // Poids des points (vue vide si le fichier n'en a pas), lus en place dans la
+    // projection comme les coordonnées
+    WeightView weights() const {
+        if (!hasWeights()) return {};
+        return WeightView(reinterpret_cast<const double*>(data_ + kPointFileHeaderSize +
+                                                          pointPayloadBytes(header_)),
+                          header_.count);
+    }
+
+    // PointSource : lecture par blocs convertis en double (StreamingKMeans)
+    void rewind() override { next_ = 0; }
+
+    size_t read(double* buffer, size_t maxRows) override {
+        const size_t rows = std::min<size_t>(maxRows, header_.count - next_);
+        const size_t values = rows * header_.dims;
+        const size_t first = next_ * header_.dims;
+        switch (type()) {
+            case PointType::Float64: convert(view<double>().data() + first, values, buffer); break;
+            case PointType::Float32: convert(view<float>().data() + first, values, buffer); break;
+            case PointType::UInt8: convert(view<uint8_t>().data() + first, values, buffer); break;
+        }
+        next_ += rows;
+        return rows;
+    }
+
+private:
+    template <typename T>
+    static void convert(const T* in, size_t values, double* out) {
+        for (size_t i = 0; i < values; ++i) out[i] = static_cast<double>(in[i]);
+    }
+
+    void validate(const std::string& path) {
+        if (file_.size() < kPointFileHeaderSize) {
+            throw std::runtime_error("MappedPointFile: fichier trop court " + path);
+        }
+        std::memcpy(&header_, data_, sizeof(header_));
+        if (std::memcmp(header_.magic, kPointFileMagic, 4) != 0 || header_.version != kPointFileVersion) {
+            throw std::runtime_error("MappedPointFile: " + path + " n'est pas un fichier .kmp v1");
+        }
+        if (header_.dims == 0 || header_.type > static_cast<uint32_t>(PointType::UInt8)) {
+            throw std::runtime_error("MappedPointFile: en-tête invalide dans " + path);
+        }
+        // Nombre de points borné par la taille du fichier avant tout produit : un
+        // en-tête forgé ne peut pas faire déborder le calcul de la taille attendue
+        const size_t rowBytes = static_cast<size_t>(header_.dims) * pointTypeSize(static_cast<PointType>(header_.type)) +
+                                (hasWeights() ? sizeof(double) : 0);
+        if (header_.count > (file_.size() - kPointFileHeaderSize) / rowBytes) {
+            throw std::runtime_error("MappedPointFile: fichier tronqué " + path);
+        }
+        size_t expected = kPointFileHeaderSize + pointPayloadBytes(header_) +
+                          (hasWeights() ? header_.count * sizeof(double) : 0);
+        if (file_.size() < expected) {
+            throw std::runtime_error("MappedPointFile: fichier tronqué " + path);
+        }
+    }
+
+    MappedFile file_;
+    const char* data_;
+    PointFileHeader header_{};
+    size_t next_ = 0;
+};
+
+// Vrai si le fichier commence par la signature .kmp
+inline bool isPointFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[4] = {};
+    return in.read(magic, 4) && std::memcmp(magic, kPointFileMagic, 4) == 0;
+}
+
+} // namespace KMeansLib
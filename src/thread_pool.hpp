@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace KMeansLib {
+
+// Pool de threads minimal pour les boucles parallèles de K-means.
+// Les threads sont créés une seule fois et réutilisés à chaque parallelFor(),
+// le thread appelant participe aussi au travail.
+class ThreadPool {
+public:
+    // numThreads = nombre total de threads (appelant compris), 0 = tous les coeurs
+    explicit ThreadPool(int numThreads = 1) {
+        if (numThreads <= 0) {
+            numThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        }
+        for (int i = 1; i < numThreads; ++i) {
+            workers_.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Exécute fn(i) pour chaque i de [0, count) et attend la fin de toutes les tâches.
+    // L'ordre d'exécution n'est pas garanti : fn ne doit écrire que dans des zones
+    // propres à l'indice i.
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+        if (workers_.empty() || count <= 1) {
+            for (size_t i = 0; i < count; ++i) fn(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &fn;
+            jobCount_ = count;
+            next_ = 0;
+            busy_ = static_cast<int>(workers_.size());
+            ++generation_;
+        }
+        wake_.notify_all();
+        runTasks(fn, count);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return busy_ == 0; });
+        job_ = nullptr;
+    }
+
+private:
+    void runTasks(const std::function<void(size_t)>& fn, size_t count) {
+        for (size_t i = next_++; i < count; i = next_++) {
+            fn(i);
+        }
+    }
+
+    void workerLoop() {
+        size_t seenGeneration = 0;
+        for (;;) {
+            const std::function<void(size_t)>* job;
+            size_t count;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seenGeneration; });
+                if (stop_) return;
+                seenGeneration = generation_;
+                job = job_;
+                count = jobCount_;
+            }
+            runTasks(*job, count);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (--busy_ == 0) done_.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(size_t)>* job_ = nullptr;
+    size_t jobCount_ = 0;
+    std::atomic<size_t> next_{0};
+    size_t generation_ = 0;
+    int busy_ = 0;
+    bool stop_ = false;
+};
+
+// File bornée entre les étapes d'un pipeline producteur / consommateur.
+// push() bloque tant que la file est pleine (contre-pression : un producteur
+// rapide ne peut pas accumuler plus de `capacity` éléments en mémoire), pop()
+// bloque tant qu'elle est vide et renvoie false une fois la file fermée et vidée.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(1, capacity)) {}
+
+    void push(T value) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this] { return items_.size() < capacity_; });
+        items_.push_back(std::move(value));
+        notEmpty_.notify_one();
+    }
+
+    bool pop(T& value) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+        value = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // Plus aucun push() : les consommateurs terminent après avoir vidé la file
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+    bool closed_ = false;
+};
+
+} // namespace KMeansLib
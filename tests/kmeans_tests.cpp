@@ -0,0 +1,430 @@
+// Tests de non-régression du moteur K-means et des formats de fichiers.
+//
+//   kmeans_tests <cas>    lance un cas (voir kCases), code de retour non nul en cas d'échec
+//
+// Chaque cas est enregistré séparément auprès de ctest (CMakeLists.txt). Les
+// données sont synthétiques et tirées avec une graine fixe ; les fichiers
+// temporaires sont créés dans le répertoire courant puis supprimés.
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "indexed_image.hpp"
+#include "kmeans_lib.hpp"
+#include "kmeans_online.hpp"
+#include "point_file.hpp"
+
+using namespace std;
+using namespace KMeansLib;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            cerr << __FILE__ << ':' << __LINE__ << ": échec de " << #condition << '\n';   \
+            ++failures;                                                                   \
+        }                                                                                 \
+    } while (0)
+
+// Nuages gaussiens autour de `clusters` centres tirés dans [0, 100]^dims
+PointMatrix gaussianClusters(size_t n, size_t dims, int clusters, uint64_t seed) {
+    mt19937_64 rng(seed);
+    uniform_real_distribution<double> center(0.0, 100.0);
+    normal_distribution<double> noise(0.0, 4.0);
+    PointMatrix centers(clusters, dims);
+    for (int c = 0; c < clusters; ++c) {
+        for (size_t d = 0; d < dims; ++d) centers[c][d] = center(rng);
+    }
+    PointMatrix points(n, dims);
+    for (size_t i = 0; i < n; ++i) {
+        const double* c = centers[i % clusters];
+        for (size_t d = 0; d < dims; ++d) points[i][d] = c[d] + noise(rng);
+    }
+    return points;
+}
+
+// Pixels BGR tirés dans une palette de `colors` couleurs (beaucoup de doublons)
+BasicPointMatrix<uint8_t> palettePixels(size_t n, int colors, uint64_t seed) {
+    mt19937_64 rng(seed);
+    uniform_int_distribution<int> channel(0, 255);
+    uniform_int_distribution<int> pick(0, colors - 1);
+    BasicPointMatrix<uint8_t> palette(colors, 3);
+    for (int c = 0; c < colors; ++c) {
+        for (size_t d = 0; d < 3; ++d) palette[c][d] = static_cast<uint8_t>(channel(rng));
+    }
+    BasicPointMatrix<uint8_t> pixels(n, 3);
+    for (size_t i = 0; i < n; ++i) {
+        const uint8_t* color = palette[pick(rng)];
+        std::copy(color, color + 3, pixels[i]);
+    }
+    return pixels;
+}
+
+bool sameMatrix(const PointMatrix& a, const PointMatrix& b, double tolerance = 0.0) {
+    if (a.rows() != b.rows() || a.cols() != b.cols()) return false;
+    for (size_t i = 0; i < a.rows(); ++i) {
+        for (size_t d = 0; d < a.cols(); ++d) {
+            if (!(std::abs(a[i][d] - b[i][d]) <= tolerance)) return false;
+        }
+    }
+    return true;
+}
+
+// Le découpage en blocs ne dépend que de N : le résultat doit être identique au
+// bit près quel que soit le nombre de threads
+void testThreadInvariance() {
+    const PointMatrix points = gaussianClusters(60000, 3, 12, 1);
+    for (SeedingMethod seeding : {SeedingMethod::KMeansPlusPlus, SeedingMethod::KMeansParallel}) {
+        KMeansResult reference;
+        for (int threads : {1, 2, 5, 8}) {
+            KMeansOptions options;
+            options.seed = 42;
+            options.seeding = seeding;
+            options.numThreads = threads;
+            options.algorithm = KMeansAlgorithm::Lloyd;
+            KMeansResult result = KMeans<double, 3>(options).fit(points.view(), 12);
+            if (threads == 1) {
+                reference = result;
+                continue;
+            }
+            CHECK(result.assignments == reference.assignments);
+            CHECK(sameMatrix(result.centroids, reference.centroids));
+            CHECK(result.finalCost == reference.finalCost);
+            CHECK(result.iterations == reference.iterations);
+        }
+    }
+
+    const BasicPointMatrix<uint8_t> pixels = palettePixels(50000, 300, 2);
+    KMeansResult reference;
+    for (int threads : {1, 3, 8}) {
+        KMeansOptions options;
+        options.seed = 7;
+        options.numThreads = threads;
+        KMeansResult result = KMeans<uint8_t, 3>(options).fit(pixels.view(), 16);
+        if (threads == 1) {
+            reference = result;
+            continue;
+        }
+        CHECK(result.assignments == reference.assignments);
+        CHECK(sameMatrix(result.centroids, reference.centroids));
+    }
+}
+
+// Hamerly et Elkan n'évitent que des distances qui ne peuvent pas changer
+// l'assignation : mêmes labels que Lloyd à partir de la même initialisation
+void testBoundedMatchesLloyd() {
+    for (size_t dims : {size_t(3), size_t(40)}) {
+        const PointMatrix points = gaussianClusters(20000, dims, 20, 3 + dims);
+        const int k = dims == 3 ? 20 : 80;
+        KMeansResult lloyd;
+        for (KMeansAlgorithm algorithm : {KMeansAlgorithm::Lloyd, KMeansAlgorithm::Hamerly, KMeansAlgorithm::Elkan}) {
+            KMeansOptions options;
+            options.seed = 11;
+            options.algorithm = algorithm;
+            options.maxIterations = 300;
+            KMeansResult result = KMeans<double>(options).fit(points.view(), k);
+            if (algorithm == KMeansAlgorithm::Lloyd) {
+                lloyd = result;
+                continue;
+            }
+            CHECK(result.assignments == lloyd.assignments);
+            CHECK(sameMatrix(result.centroids, lloyd.centroids, 1e-9));
+            CHECK(std::abs(result.finalCost - lloyd.finalCost) <= 1e-9 * lloyd.finalCost);
+        }
+    }
+}
+
+// Arrêt sur une tolérance ou sur maxIterations : les labels et le coût rendus
+// correspondent aux centroïdes rendus (et non à ceux d'avant la dernière mise à jour)
+void testFinalLabelsMatchCentroids() {
+    const PointMatrix points = gaussianClusters(20000, 3, 15, 13);
+    for (KMeansAlgorithm algorithm : {KMeansAlgorithm::Lloyd, KMeansAlgorithm::Hamerly, KMeansAlgorithm::Elkan}) {
+        for (bool collectStats : {false, true}) {
+            KMeansOptions options;
+            options.seed = 4;
+            options.algorithm = algorithm;
+            options.collectStats = collectStats;
+            options.maxIterations = 3;
+            options.changedTolerance = 0.01;
+            KMeans<double, 3> engine(options);
+            const KMeansResult result = engine.fit(points.view(), 15);
+            std::vector<int> labels;
+            engine.assign(points.view(), result.centroids, labels);
+            CHECK(result.assignments == labels);
+            CHECK(result.finalCost == engine.cost(points.view(), result.centroids, labels));
+        }
+    }
+}
+
+// La grille doit rendre exactement les labels du parcours complet, y compris le
+// plus petit indice en cas d'égalité (centroïdes en double, points équidistants)
+void testGridMatchesLinear() {
+    BasicPointMatrix<uint8_t> pixels(52 * 52 * 52, 3);
+    for (size_t i = 0; i < pixels.rows(); ++i) {
+        pixels[i][0] = static_cast<uint8_t>(i % 52 * 5);
+        pixels[i][1] = static_cast<uint8_t>(i / 52 % 52 * 5);
+        pixels[i][2] = static_cast<uint8_t>(i / (52 * 52) * 5);
+    }
+    // Centroïdes sur des coordonnées paires : beaucoup de pixels à égale distance
+    // de deux centroïdes ; un sur dix répète un centroïde précédent
+    mt19937_64 rng(5);
+    uniform_int_distribution<int> even(0, 127);
+    PointMatrix centroids(200, 3);
+    for (size_t j = 0; j < centroids.rows(); ++j) {
+        if (j >= 10 && j % 10 == 0) {
+            std::copy(centroids[j - 7], centroids[j - 7] + 3, centroids[j]);
+            continue;
+        }
+        for (size_t d = 0; d < 3; ++d) centroids[j][d] = 2.0 * even(rng);
+    }
+
+    std::vector<int> linear, grid;
+    KMeansOptions options;
+    options.centroidIndex = CentroidIndex::None;
+    KMeans<uint8_t, 3>(options).assign(pixels.view(), centroids, linear);
+    options.centroidIndex = CentroidIndex::Grid;
+    KMeans<uint8_t, 3>(options).assign(pixels.view(), centroids, grid);
+    CHECK(grid == linear);
+
+    // Points réels et centroïdes quelconques, dont certains hors de la boîte des points
+    const PointMatrix points = gaussianClusters(30000, 3, 40, 6);
+    uniform_real_distribution<double> coordinate(-20.0, 120.0);
+    PointMatrix spread(160, 3);
+    for (size_t j = 0; j < spread.rows(); ++j) {
+        for (size_t d = 0; d < 3; ++d) spread[j][d] = coordinate(rng);
+    }
+    options.centroidIndex = CentroidIndex::None;
+    KMeans<double, 3>(options).assign(points.view(), spread, linear);
+    options.centroidIndex = CentroidIndex::Grid;
+    KMeans<double, 3>(options).assign(points.view(), spread, grid);
+    CHECK(grid == linear);
+}
+
+// K-means sur l'histogramme (une entrée par couleur distincte, pondérée par son
+// nombre de pixels) : mêmes centroïdes et mêmes labels que sur tous les pixels
+void testHistogramMatchesPixels() {
+    const BasicPointMatrix<uint8_t> pixels = palettePixels(80000, 500, 8);
+    std::map<std::vector<uint8_t>, size_t> entries;
+    std::vector<size_t> pixelEntries(pixels.rows());
+    std::vector<double> counts;
+    for (size_t i = 0; i < pixels.rows(); ++i) {
+        auto inserted = entries.emplace(std::vector<uint8_t>(pixels[i], pixels[i] + 3), counts.size());
+        if (inserted.second) counts.push_back(0.0);
+        counts[inserted.first->second] += 1.0;
+        pixelEntries[i] = inserted.first->second;
+    }
+    PointMatrix colors(counts.size(), 3);
+    for (const auto& entry : entries) {
+        for (size_t d = 0; d < 3; ++d) colors[entry.second][d] = entry.first[d];
+    }
+
+    KMeansOptions options;
+    options.seed = 3;
+    KMeans<uint8_t, 3> pixelEngine(options);
+    KMeans<double, 3> histogramEngine(options);
+    PointMatrix pixelCentroids = pixelEngine.initialize(pixels.view(), 24);
+    PointMatrix histogramCentroids = pixelCentroids;
+
+    std::vector<int> pixelLabels, histogramLabels;
+    for (int iteration = 0; iteration < 100; ++iteration) {
+        const size_t changed = pixelEngine.iterate(pixels.view(), pixelCentroids, pixelLabels);
+        histogramEngine.iterate(colors.view(), histogramCentroids, histogramLabels, counts);
+        if (changed == 0) break;
+    }
+    CHECK(sameMatrix(pixelCentroids, histogramCentroids, 1e-9));
+    size_t mismatches = 0;
+    for (size_t i = 0; i < pixels.rows(); ++i) mismatches += pixelLabels[i] != histogramLabels[pixelEntries[i]];
+    CHECK(mismatches == 0);
+
+    const double pixelCost = pixelEngine.cost(pixels.view(), pixelCentroids, pixelLabels);
+    const double histogramCost = histogramEngine.cost(colors.view(), histogramCentroids, histogramLabels, counts);
+    CHECK(std::abs(pixelCost - histogramCost) <= 1e-9 * pixelCost);
+}
+
+// .kmp : points et poids relus tels qu'écrits (double exact, uint8 arrondi)
+void testPointFileRoundTrip() {
+    const string path = "kmeans_tests_points.kmp";
+    const PointMatrix points = gaussianClusters(1001, 5, 4, 9);
+    std::vector<double> weights(points.rows());
+    for (size_t i = 0; i < weights.size(); ++i) weights[i] = 0.5 + static_cast<double>(i % 7);
+    {
+        PointFileWriter writer(path, 5, PointType::Float64, true);
+        for (size_t i = 0; i < points.rows(); ++i) writer.append(points[i], weights[i]);
+        writer.close();
+    }
+    {
+        MappedPointFile file(path);
+        CHECK(file.count() == points.rows());
+        CHECK(file.dims() == 5);
+        CHECK(file.hasWeights());
+        const WeightView mapped = file.weights();
+        CHECK(mapped.size() == weights.size() && std::equal(mapped.begin(), mapped.end(), weights.begin()));
+        CHECK(sameMatrix(PointMatrix(file.view<double>()), points));
+    }
+
+    const double pixel[3] = {0.0, 127.6, 255.0};
+    {
+        PointFileWriter writer(path, 3, PointType::UInt8);
+        for (int i = 0; i < 3; ++i) writer.append(pixel);
+        writer.close();
+    }
+    {
+        MappedPointFile file(path);
+        CHECK(file.type() == PointType::UInt8);
+        CHECK(!file.hasWeights());
+        const PixelView view = file.view<uint8_t>();
+        CHECK(view.rows() == 3);
+        CHECK(view.row(2)[0] == 0 && view.row(2)[1] == 128 && view.row(2)[2] == 255);
+    }
+    std::remove(path.c_str());
+}
+
+// .kmi : écriture d'un bloc ou par bandes (IndexedImageWriter), même fichier,
+// relu avec les mêmes indices et la même palette
+void testIndexedImageRoundTrip() {
+    const string path = "kmeans_tests_image.kmi", streamedPath = "kmeans_tests_streamed.kmi";
+    mt19937_64 rng(10);
+    for (int colors : {2, 3, 16, 200}) {
+        const int width = 37, height = 23;
+        PointMatrix centroids(colors, 3);
+        uniform_int_distribution<int> channel(0, 255);
+        for (int j = 0; j < colors; ++j) {
+            for (size_t d = 0; d < 3; ++d) centroids[j][d] = channel(rng);
+        }
+        uniform_int_distribution<int> label(0, colors - 1);
+        std::vector<int> labels(static_cast<size_t>(width) * height);
+        for (int& l : labels) l = label(rng);
+
+        const IndexedImage image = makeIndexedImage(labels, width, height, centroids);
+        writeIndexedImage(path, image);
+        {
+            IndexedImageWriter writer(streamedPath, width, height, centroids);
+            for (int y = 0; y < height; y += 5) {
+                writer.write(labels.data() + static_cast<size_t>(y) * width, std::min(5, height - y));
+            }
+            writer.close();
+        }
+
+        const IndexedImage read = readIndexedImage(path);
+        const IndexedImage streamed = readIndexedImage(streamedPath);
+        CHECK(read.width == width && read.height == height && read.bits == indexBits(colors));
+        CHECK(read.palette == image.palette && read.indices == image.indices);
+        CHECK(streamed.palette == image.palette && streamed.indices == image.indices);
+        size_t mismatches = 0;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) mismatches += read.index(x, y) != labels[y * width + x];
+        }
+        CHECK(mismatches == 0);
+    }
+    std::remove(path.c_str());
+    std::remove(streamedPath.c_str());
+}
+
+// KMON : un état restauré donne les mêmes centroïdes, la même inertie et le
+// même instantané ; les points suivants sont traités de la même façon
+void testOnlineSnapshotRoundTrip() {
+    const PointMatrix points = gaussianClusters(5000, 3, 6, 12);
+    OnlineKMeans<3> original(8, 3, KMeansOptions(), 0.999);
+    for (size_t i = 0; i < 4000; ++i) original.add(points[i]);
+
+    std::stringstream snapshot;
+    original.snapshot(snapshot);
+    OnlineKMeans<3> restored(8, 3, KMeansOptions(), 0.999);
+    restored.restore(snapshot);
+    CHECK(restored.seen() == original.seen());
+    CHECK(restored.active() == original.active());
+    CHECK(sameMatrix(restored.centroids(), original.centroids(), 1e-9));
+    CHECK(std::abs(restored.inertia() - original.inertia()) <= 1e-9 * original.inertia());
+
+    std::stringstream again;
+    restored.snapshot(again);
+    CHECK(again.str() == snapshot.str());
+
+    for (size_t i = 4000; i < points.rows(); ++i) CHECK(original.add(points[i]) == restored.add(points[i]));
+    CHECK(sameMatrix(restored.centroids(), original.centroids(), 1e-9));
+
+    // Instantané de 2 clusters relu par un état qui en a déjà 3 : le troisième
+    // cluster, rouvert par add(), ne garde rien de l'ancien état
+    OnlineKMeans<3> small(3, 3);
+    const double a[3] = {0.0, 0.0, 0.0}, b[3] = {10.0, 0.0, 0.0}, c[3] = {50.0, 0.0, 0.0};
+    small.add(a);
+    small.add(b);
+    std::stringstream twoClusters;
+    small.snapshot(twoClusters);
+    OnlineKMeans<3> crowded(3, 3);
+    for (double x : {100.0, 200.0, 300.0}) {
+        const double p[3] = {x, x, x};
+        crowded.add(p);
+    }
+    crowded.restore(twoClusters);
+    CHECK(crowded.active() == 2);
+    CHECK(crowded.add(c) == 2);
+    CHECK(crowded.centroids()[2][0] == 50.0 && crowded.centroids()[2][1] == 0.0);
+    CHECK(crowded.weight(2) == 1.0);
+
+    // Le facteur d'oubli du constructeur est gardé ; un instantané invalide est refusé
+    OnlineKMeans<3> other(8, 3, KMeansOptions(), 0.5);
+    std::istringstream in(snapshot.str());
+    other.restore(in);
+    CHECK(other.decay() == 0.5);
+    std::string corrupted = snapshot.str();
+    const double badDecay = 2.0;
+    std::memcpy(&corrupted[offsetof(OnlineHeader, decay)], &badDecay, sizeof(badDecay));
+    std::istringstream bad(corrupted);
+    bool rejected = false;
+    try {
+        other.restore(bad);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+}
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+const TestCase kCases[] = {
+    {"thread_invariance", testThreadInvariance},
+    {"bounded_vs_lloyd", testBoundedMatchesLloyd},
+    {"final_labels_match_centroids", testFinalLabelsMatchCentroids},
+    {"grid_vs_linear", testGridMatchesLinear},
+    {"histogram_vs_pixels", testHistogramMatchesPixels},
+    {"point_file_roundtrip", testPointFileRoundTrip},
+    {"indexed_image_roundtrip", testIndexedImageRoundTrip},
+    {"online_snapshot_roundtrip", testOnlineSnapshotRoundTrip},
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        cerr << "Usage: " << argv[0] << " <case>\n";
+        for (const TestCase& test : kCases) cerr << "  " << test.name << "\n";
+        return 2;
+    }
+    for (const TestCase& test : kCases) {
+        if (argv[1] != string(test.name)) continue;
+        try {
+            test.run();
+        } catch (const std::exception& e) {
+            cerr << "Erreur: " << e.what() << "\n";
+            return 1;
+        }
+        if (failures) cerr << test.name << ": " << failures << " vérification(s) en échec\n";
+        return failures ? 1 : 0;
+    }
+    cerr << "Erreur: cas inconnu " << argv[1] << "\n";
+    return 2;
+}